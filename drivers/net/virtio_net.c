@@ -194,16 +194,36 @@ static void give_pages(struct receive_queue *rq, struct page *page)
 	rq->pages = page;
 }
 
+/*
+ * Refill rq->pages with enough pages for a big packet buffer in one call
+ * to the page allocator, instead of one call per page.
+ */
+static void alloc_pages_for_big(struct receive_queue *rq, gfp_t gfp_mask)
+{
+	struct page *page, *tmp;
+	LIST_HEAD(list);
+
+	alloc_pages_bulk_list(gfp_mask, MAX_SKB_FRAGS + 2, &list);
+	list_for_each_entry_safe(page, tmp, &list, lru) {
+		list_del(&page->lru);
+		page->private = (unsigned long)rq->pages;
+		rq->pages = page;
+	}
+}
+
 static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 {
-	struct page *p = rq->pages;
+	struct page *p;
 
+	if (!rq->pages)
+		alloc_pages_for_big(rq, gfp_mask);
+
+	p = rq->pages;
 	if (p) {
 		rq->pages = (struct page *)p->private;
 		/* clear private here, it is used to chain pages */
 		p->private = 0;
-	} else
-		p = alloc_page(gfp_mask);
+	}
 	return p;
 }
 
@@ -40,6 +40,10 @@
 #include <linux/ramfs.h>
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
+#include <linux/poll.h>
+#include <linux/kthread.h>
+#include <linux/vmalloc.h>
+#include <linux/cred.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -82,6 +86,20 @@ struct ctx_rq_wait {
 	atomic_t count;
 };
 
+#define AIO_SQRING_MAX_ENTRIES	4096
+#define AIO_SQ_IDLE_MS		1000
+#define AIO_MAX_FIXED_BUFS	1024
+#define AIO_MAX_FIXED_BUF_SIZE	(1UL << 30)
+#define AIO_MAX_FIXED_FILES	4096
+
+/* A buffer registered with AIO_REGISTER_BUFFERS, pinned for the ctx lifetime */
+struct aio_mapped_buf {
+	unsigned long		ubuf;
+	size_t			len;
+	unsigned int		nr_bvecs;
+	struct bio_vec		*bvec;
+};
+
 struct kioctx {
 	struct percpu_ref	users;
 	atomic_t		dead;
@@ -154,6 +172,32 @@ struct kioctx {
 	struct file		*aio_ring_file;
 
 	unsigned		id;
+
+	/*
+	 * Submission ring and registered buffers and files, see
+	 * io_register(). They are set up at most once and are only
+	 * released by free_ioctx(), once no request can use them any more.
+	 */
+	struct mutex		sq_lock;	/* serializes ring consumers */
+	struct aio_sqring	*sq_ring;	/* kernel mapping of the ring */
+	struct iocb __user	*sq_uiocbs;
+	unsigned		sq_mask;
+	unsigned		sq_head;
+	struct page		**sq_pages;
+	unsigned		sq_nr_pages;
+
+	struct task_struct	*sq_thread;	/* AIO_SQRING_POLL */
+	wait_queue_head_t	sq_wait;
+	unsigned long		sq_idle;
+	const struct cred	*sq_creds;
+
+	struct mm_struct	*reg_mm;	/* for pinned_vm and sq_thread */
+	unsigned long		reg_pinned;
+
+	struct aio_mapped_buf	*fixed_bufs;
+	unsigned		nr_fixed_bufs;
+	struct file		**fixed_files;
+	unsigned		nr_fixed_files;
 };
 
 /*
@@ -169,6 +213,28 @@ struct kioctx {
  */
 #define KIOCB_CANCELLED		((void *) (~0ULL))
 
+/* IOCB_CMD_FSYNC and IOCB_CMD_FDSYNC, run from a workqueue */
+struct aio_fsync {
+	struct work_struct	work;
+	bool			datasync;
+};
+
+/*
+ * IOCB_CMD_POLL: ->wait sits on the file's wait queue until one of
+ * ->events shows up, and ->work then completes the request. Until
+ * submission is done (->armed), the wakeup handler only records that it
+ * fired (->woken) and leaves the rest to the submitter.
+ */
+struct aio_poll {
+	wait_queue_head_t	*head;
+	unsigned int		events;
+	bool			armed;
+	bool			woken;
+	bool			cancelled;
+	wait_queue_t		wait;
+	struct work_struct	work;
+};
+
 struct aio_kiocb {
 	struct kiocb		common;
 
@@ -186,6 +252,14 @@ struct aio_kiocb {
 	 * this is the underlying eventfd context to deliver events to.
 	 */
 	struct eventfd_ctx	*ki_eventfd;
+
+	/* ki_filp comes from ctx->fixed_files and holds no reference */
+	bool			ki_fixed_file;
+
+	union {
+		struct aio_fsync	fsync;
+		struct aio_poll		poll;
+	};
 };
 
 /*------ sysctl variables----*/
@@ -559,12 +633,46 @@ static int kiocb_cancel(struct aio_kiocb *kiocb)
 	return cancel(&kiocb->common);
 }
 
+static void aio_free_registered(struct kioctx *ctx)
+{
+	unsigned i, j;
+
+	if (ctx->sq_ring) {
+		vunmap((void *)((unsigned long)ctx->sq_ring & PAGE_MASK));
+		release_pages(ctx->sq_pages, ctx->sq_nr_pages, false);
+		kvfree(ctx->sq_pages);
+	}
+	if (ctx->sq_creds)
+		put_cred(ctx->sq_creds);
+
+	for (i = 0; i < ctx->nr_fixed_bufs; i++) {
+		struct aio_mapped_buf *buf = &ctx->fixed_bufs[i];
+
+		for (j = 0; j < buf->nr_bvecs; j++)
+			put_page(buf->bvec[j].bv_page);
+		kvfree(buf->bvec);
+	}
+	kfree(ctx->fixed_bufs);
+
+	for (i = 0; i < ctx->nr_fixed_files; i++)
+		fput(ctx->fixed_files[i]);
+	kfree(ctx->fixed_files);
+
+	if (ctx->reg_mm) {
+		down_write(&ctx->reg_mm->mmap_sem);
+		ctx->reg_mm->pinned_vm -= ctx->reg_pinned;
+		up_write(&ctx->reg_mm->mmap_sem);
+		mmdrop(ctx->reg_mm);
+	}
+}
+
 static void free_ioctx(struct work_struct *work)
 {
 	struct kioctx *ctx = container_of(work, struct kioctx, free_work);
 
 	pr_debug("freeing %p\n", ctx);
 
+	aio_free_registered(ctx);
 	aio_free_ring(ctx);
 	free_percpu(ctx->cpu);
 	percpu_ref_exit(&ctx->reqs);
@@ -712,6 +820,8 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 	ctx->max_reqs = nr_events;
 
 	spin_lock_init(&ctx->ctx_lock);
+	mutex_init(&ctx->sq_lock);
+	init_waitqueue_head(&ctx->sq_wait);
 	spin_lock_init(&ctx->completion_lock);
 	mutex_init(&ctx->ring_lock);
 	/* Protect against page migration throughout kiotx setup by keeping
@@ -791,6 +901,7 @@ static int kill_ioctx(struct mm_struct *mm, struct kioctx *ctx,
 		      struct ctx_rq_wait *wait)
 {
 	struct kioctx_table *table;
+	struct task_struct *sq_thread;
 
 	spin_lock(&mm->ioctx_lock);
 	if (atomic_xchg(&ctx->dead, 1)) {
@@ -806,6 +917,16 @@ static int kill_ioctx(struct mm_struct *mm, struct kioctx *ctx,
 	/* percpu_ref_kill() will do the necessary call_rcu() */
 	wake_up_all(&ctx->wait);
 
+	/*
+	 * ->dead keeps io_register() from starting a polling thread from
+	 * now on, and the thread submits on behalf of ctx->users.
+	 */
+	mutex_lock(&ctx->sq_lock);
+	sq_thread = ctx->sq_thread;
+	mutex_unlock(&ctx->sq_lock);
+	if (sq_thread)
+		kthread_stop(sq_thread);
+
 	/*
 	 * It'd be more correct to do this in free_ioctx(), after all
 	 * the outstanding kiocbs have finished - but by then io_destroy
@@ -1010,7 +1131,7 @@ out_put:
 
 static void kiocb_free(struct aio_kiocb *req)
 {
-	if (req->common.ki_filp)
+	if (req->common.ki_filp && !req->ki_fixed_file)
 		fput(req->common.ki_filp);
 	if (req->ki_eventfd != NULL)
 		eventfd_ctx_put(req->ki_eventfd);
@@ -1387,12 +1508,281 @@ static int aio_setup_vectored_rw(int rw, char __user *buf, size_t len,
 				len, UIO_FASTIOV, iovec, iter);
 }
 
+static void aio_fsync_work(struct work_struct *work)
+{
+	struct aio_kiocb *iocb = container_of(work, struct aio_kiocb,
+					      fsync.work);
+
+	aio_complete(&iocb->common,
+		     vfs_fsync(iocb->common.ki_filp, iocb->fsync.datasync), 0);
+}
+
+/*
+ * Files providing ->aio_fsync() get to do it their way, for everybody
+ * else ->fsync() is run from a workqueue so that io_submit() does not
+ * block on it.
+ */
+static ssize_t aio_fsync(struct kiocb *req, bool datasync)
+{
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, common);
+	struct file *file = req->ki_filp;
+
+	if (file->f_op->aio_fsync)
+		return file->f_op->aio_fsync(req, datasync);
+
+	iocb->fsync.datasync = datasync;
+	INIT_WORK(&iocb->fsync.work, aio_fsync_work);
+	schedule_work(&iocb->fsync.work);
+	return -EIOCBQUEUED;
+}
+
+/*
+ * Returns req->head locked, or NULL if the wait queue has been torn down
+ * under us (POLLFREE). Wait queue heads sending POLLFREE are RCU-freed, the
+ * same as for epoll, see ep_remove_wait_queue().
+ */
+static wait_queue_head_t *aio_poll_lock_head(struct aio_poll *req,
+					     unsigned long *flags)
+{
+	wait_queue_head_t *head;
+
+	rcu_read_lock();
+	head = smp_load_acquire(&req->head);
+	if (head) {
+		spin_lock_irqsave(&head->lock, *flags);
+		if (unlikely(!req->head)) {
+			spin_unlock_irqrestore(&head->lock, *flags);
+			head = NULL;
+		}
+	}
+	rcu_read_unlock();
+
+	return head;
+}
+
+static void aio_poll_work(struct work_struct *work)
+{
+	struct aio_poll *req = container_of(work, struct aio_poll, work);
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, poll);
+	struct file *file = iocb->common.ki_filp;
+	wait_queue_head_t *head;
+	unsigned int mask = 0;
+	unsigned long flags;
+	poll_table pt;
+
+	init_poll_funcptr(&pt, NULL);
+	pt._key = req->events;
+
+	if (!READ_ONCE(req->cancelled)) {
+		mask = file->f_op->poll(file, &pt) & req->events;
+		if (mask)
+			goto complete;
+	}
+
+	head = aio_poll_lock_head(req, &flags);
+	if (!head) {
+		mask = POLLHUP;
+		goto complete;
+	}
+	if (req->cancelled) {
+		spin_unlock_irqrestore(&head->lock, flags);
+		goto complete;
+	}
+	__add_wait_queue(head, &req->wait);
+	spin_unlock_irqrestore(&head->lock, flags);
+
+	/*
+	 * Poll again now that we are back on the wait queue, an event that
+	 * showed up in between would otherwise be lost.
+	 */
+	mask = file->f_op->poll(file, &pt) & req->events;
+	if (!mask)
+		return;
+
+	head = aio_poll_lock_head(req, &flags);
+	if (!head)
+		return;
+	if (list_empty(&req->wait.task_list)) {
+		/* a wakeup or a cancel got there first and requeued us */
+		spin_unlock_irqrestore(&head->lock, flags);
+		return;
+	}
+	list_del_init(&req->wait.task_list);
+	spin_unlock_irqrestore(&head->lock, flags);
+
+complete:
+	aio_complete(&iocb->common, mask, 0);
+}
+
+static int aio_poll_wake(wait_queue_t *wait, unsigned mode, int sync,
+			 void *key)
+{
+	struct aio_poll *req = container_of(wait, struct aio_poll, wait);
+	unsigned long mask = (unsigned long)key;
+
+	/* for instances that support it check for an event match first */
+	if (mask && !(mask & (req->events | POLLFREE)))
+		return 0;
+
+	/* whead->lock is held by the caller */
+	list_del_init(&wait->task_list);
+	if (req->armed)
+		schedule_work(&req->work);
+	else
+		req->woken = true;
+
+	/* ->head may be freed as soon as we return, see aio_poll_lock_head() */
+	if (mask & POLLFREE)
+		smp_store_release(&req->head, NULL);
+
+	return 1;
+}
+
+/* Called with ctx->ctx_lock held */
+static int aio_poll_cancel(struct kiocb *kiocb)
+{
+	struct aio_kiocb *iocb = container_of(kiocb, struct aio_kiocb, common);
+	struct aio_poll *req = &iocb->poll;
+	wait_queue_head_t *head;
+	unsigned long flags;
+
+	head = aio_poll_lock_head(req, &flags);
+	if (!head)
+		return 0;
+
+	req->cancelled = true;
+	if (!list_empty(&req->wait.task_list)) {
+		list_del_init(&req->wait.task_list);
+		schedule_work(&req->work);
+	}
+	spin_unlock_irqrestore(&head->lock, flags);
+
+	return 0;
+}
+
+struct aio_poll_table {
+	poll_table		pt;
+	struct aio_kiocb	*iocb;
+	int			error;
+};
+
+static void aio_poll_queue_proc(struct file *file, wait_queue_head_t *head,
+				poll_table *p)
+{
+	struct aio_poll_table *apt = container_of(p, struct aio_poll_table, pt);
+	struct aio_poll *req = &apt->iocb->poll;
+
+	/* multiple wait queues per file are not supported */
+	if (unlikely(req->head)) {
+		apt->error = -EINVAL;
+		return;
+	}
+
+	apt->error = 0;
+	req->head = head;
+	add_wait_queue(head, &req->wait);
+}
+
+/*
+ * aio_poll:
+ *	Arms an IOCB_CMD_POLL request. The events to wait for are passed in
+ *	aio_buf, and the request completes with the ready events in res.
+ *	Returns the ready events if there already are some, -EIOCBQUEUED
+ *	once the request is waiting, or an error.
+ */
+static ssize_t aio_poll(struct kiocb *kiocb, unsigned long events, size_t len)
+{
+	struct aio_kiocb *iocb = container_of(kiocb, struct aio_kiocb, common);
+	struct kioctx *ctx = iocb->ki_ctx;
+	struct aio_poll *req = &iocb->poll;
+	struct file *file = kiocb->ki_filp;
+	struct aio_poll_table apt;
+	wait_queue_head_t *head;
+	unsigned long flags;
+	unsigned int mask;
+
+	/* reject unknown events and fields that are not defined for poll */
+	if ((u16)events != events || len || kiocb->ki_pos)
+		return -EINVAL;
+	if (!file->f_op->poll)
+		return -EINVAL;
+
+	req->events = events | POLLERR | POLLHUP;
+	INIT_WORK(&req->work, aio_poll_work);
+	init_waitqueue_func_entry(&req->wait, aio_poll_wake);
+	INIT_LIST_HEAD(&req->wait.task_list);
+
+	apt.pt._qproc = aio_poll_queue_proc;
+	apt.pt._key = req->events;
+	apt.iocb = iocb;
+	apt.error = -EINVAL;	/* the file never called poll_wait() */
+
+	mask = file->f_op->poll(file, &apt.pt) & req->events;
+
+	/*
+	 * Once ->armed is set and the locks are dropped, the wakeup handler
+	 * owns the request and we must not look at it again.
+	 */
+	spin_lock_irq(&ctx->ctx_lock);
+	head = aio_poll_lock_head(req, &flags);
+	if (unlikely(!head)) {
+		/*
+		 * Either ->poll() never queued us, or a POLLFREE wakeup has
+		 * already taken us off a wait queue that is going away.
+		 */
+		spin_unlock_irq(&ctx->ctx_lock);
+		if (apt.error)
+			return apt.error;
+		return mask ? mask : POLLHUP;
+	}
+	if (mask || apt.error) {
+		list_del_init(&req->wait.task_list);
+	} else {
+		/*
+		 * The work may put the request back on the wait queue, so it
+		 * has to be cancellable even if an event raced with ->poll().
+		 */
+		req->armed = true;
+		list_add_tail(&iocb->ki_list, &ctx->active_reqs);
+		iocb->ki_cancel = aio_poll_cancel;
+		if (req->woken)
+			schedule_work(&req->work);
+	}
+	spin_unlock_irqrestore(&head->lock, flags);
+	spin_unlock_irq(&ctx->ctx_lock);
+
+	if (apt.error)
+		return apt.error;
+	return mask ? mask : -EIOCBQUEUED;
+}
+
+/*
+ * Sets up @iter for [@buf, @buf + @len) inside the registered buffer @fixed,
+ * without touching the user page tables.
+ */
+static int aio_import_fixed(int rw, const struct aio_mapped_buf *fixed,
+			    char __user *buf, size_t len,
+			    struct iov_iter *iter)
+{
+	unsigned long start = (unsigned long)buf;
+
+	if (unlikely(start < fixed->ubuf || start + len < start ||
+		     start + len > fixed->ubuf + fixed->len))
+		return -EFAULT;
+
+	iov_iter_bvec(iter, ITER_BVEC | rw, fixed->bvec, fixed->nr_bvecs,
+		      start - fixed->ubuf + len);
+	iov_iter_advance(iter, start - fixed->ubuf);
+	return 0;
+}
+
 /*
  * aio_run_iocb:
  *	Performs the initial checks and io submission.
  */
 static ssize_t aio_run_iocb(struct kiocb *req, unsigned opcode,
-			    char __user *buf, size_t len, bool compat)
+			    char __user *buf, size_t len, bool compat,
+			    const struct aio_mapped_buf *fixed)
 {
 	struct file *file = req->ki_filp;
 	ssize_t ret;
@@ -1402,6 +1792,9 @@ static ssize_t aio_run_iocb(struct kiocb *req, unsigned opcode,
 	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
 	struct iov_iter iter;
 
+	if (fixed && opcode != IOCB_CMD_PREAD && opcode != IOCB_CMD_PWRITE)
+		return -EINVAL;
+
 	switch (opcode) {
 	case IOCB_CMD_PREAD:
 	case IOCB_CMD_PREADV:
@@ -1423,7 +1816,11 @@ rw_common:
 		if (!iter_op)
 			return -EINVAL;
 
-		if (opcode == IOCB_CMD_PREADV || opcode == IOCB_CMD_PWRITEV)
+		if (fixed) {
+			ret = aio_import_fixed(rw, fixed, buf, len, &iter);
+			iovec = NULL;
+		} else if (opcode == IOCB_CMD_PREADV ||
+			   opcode == IOCB_CMD_PWRITEV)
 			ret = aio_setup_vectored_rw(rw, buf, len,
 						&iovec, compat, &iter);
 		else {
@@ -1451,17 +1848,17 @@ rw_common:
 		break;
 
 	case IOCB_CMD_FDSYNC:
-		if (!file->f_op->aio_fsync)
+	case IOCB_CMD_FSYNC:
+		if (!file->f_op->aio_fsync && !file->f_op->fsync)
 			return -EINVAL;
 
-		ret = file->f_op->aio_fsync(req, 1);
+		ret = aio_fsync(req, opcode == IOCB_CMD_FDSYNC);
 		break;
 
-	case IOCB_CMD_FSYNC:
-		if (!file->f_op->aio_fsync)
-			return -EINVAL;
-
-		ret = file->f_op->aio_fsync(req, 0);
+	case IOCB_CMD_POLL:
+		ret = aio_poll(req, (unsigned long)buf, len);
+		if (ret < 0 && ret != -EIOCBQUEUED)
+			return ret;
 		break;
 
 	default:
@@ -1484,14 +1881,44 @@ rw_common:
 	return 0;
 }
 
+static const struct aio_mapped_buf *aio_fixed_buf(struct kioctx *ctx,
+						  u64 index)
+{
+	/* pairs with the release in aio_register_buffers() */
+	if (index >= smp_load_acquire(&ctx->nr_fixed_bufs))
+		return NULL;
+	return &ctx->fixed_bufs[index];
+}
+
+static struct file *aio_fixed_file(struct kioctx *ctx, u32 index)
+{
+	/* pairs with the release in aio_register_files() */
+	if (index >= smp_load_acquire(&ctx->nr_fixed_files))
+		return NULL;
+	return ctx->fixed_files[index];
+}
+
 static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 			 struct iocb *iocb, bool compat)
 {
+	const struct aio_mapped_buf *fixed = NULL;
 	struct aio_kiocb *req;
 	ssize_t ret;
 
+	/* aio_reserved2 carries the buffer index for IOCB_FLAG_FIXEDBUF */
+	if (iocb->aio_flags & IOCB_FLAG_FIXEDBUF) {
+		fixed = aio_fixed_buf(ctx, iocb->aio_reserved2);
+		if (unlikely(!fixed)) {
+			pr_debug("EINVAL: bad fixed buffer index\n");
+			return -EINVAL;
+		}
+	} else if (unlikely(iocb->aio_reserved2)) {
+		pr_debug("EINVAL: reserve field set\n");
+		return -EINVAL;
+	}
+
 	/* enforce forwards compatibility on users */
-	if (unlikely(iocb->aio_reserved1 || iocb->aio_reserved2)) {
+	if (unlikely(iocb->aio_reserved1)) {
 		pr_debug("EINVAL: reserve field set\n");
 		return -EINVAL;
 	}
@@ -1510,7 +1937,12 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	if (unlikely(!req))
 		return -EAGAIN;
 
-	req->common.ki_filp = fget(iocb->aio_fildes);
+	if (iocb->aio_flags & IOCB_FLAG_FIXEDFILE) {
+		req->common.ki_filp = aio_fixed_file(ctx, iocb->aio_fildes);
+		req->ki_fixed_file = true;
+	} else if (current != ctx->sq_thread) {
+		req->common.ki_filp = fget(iocb->aio_fildes);
+	}
 	if (unlikely(!req->common.ki_filp)) {
 		ret = -EBADF;
 		goto out_put_req;
@@ -1520,6 +1952,12 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	req->common.ki_flags = iocb_flags(req->common.ki_filp);
 
 	if (iocb->aio_flags & IOCB_FLAG_RESFD) {
+		/* aio_resfd would be looked up in the sq thread's files */
+		if (unlikely(current == ctx->sq_thread)) {
+			ret = -EINVAL;
+			goto out_put_req;
+		}
+
 		/*
 		 * If the IOCB_FLAG_RESFD flag of aio_flags is set, get an
 		 * instance of the file* now. The file descriptor must be
@@ -1548,7 +1986,7 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	ret = aio_run_iocb(&req->common, iocb->aio_lio_opcode,
 			   (char __user *)(unsigned long)iocb->aio_buf,
 			   iocb->aio_nbytes,
-			   compat);
+			   compat, fixed);
 	if (ret)
 		goto out_put_req;
 
@@ -1560,6 +1998,157 @@ out_put_req:
 	return ret;
 }
 
+/*
+ * Completes an iocb that failed submission from the submission ring, as
+ * there is no syscall to return the error from.
+ */
+static int aio_complete_error(struct kioctx *ctx, struct iocb __user *user_iocb,
+			      u64 user_data, long err)
+{
+	struct aio_kiocb *req = aio_get_req(ctx);
+
+	if (unlikely(!req))
+		return -EAGAIN;
+
+	req->common.ki_complete = aio_complete;
+	req->ki_user_iocb = user_iocb;
+	req->ki_user_data = user_data;
+	aio_complete(&req->common, err, 0);
+	return 0;
+}
+
+/*
+ * aio_sqring_submit:
+ *	Submits the iocbs userspace queued on the submission ring. Returns
+ *	the number of entries consumed, or -EAGAIN if the event ring has no
+ *	room left for any of them.
+ */
+static long aio_sqring_submit(struct kioctx *ctx)
+{
+	struct aio_sqring *ring = ctx->sq_ring;
+	struct blk_plug plug;
+	unsigned head, tail;
+	long consumed = 0;
+	int ret = 0;
+
+	mutex_lock(&ctx->sq_lock);
+
+	head = ctx->sq_head;
+	/* pairs with the userspace store of ->tail after filling the iocbs */
+	tail = smp_load_acquire(&ring->tail);
+	if (tail - head > ctx->sq_mask + 1)
+		tail = head + ctx->sq_mask + 1;
+
+	blk_start_plug(&plug);
+	while (head != tail) {
+		unsigned idx = head & ctx->sq_mask;
+		struct iocb tmp;
+
+		/* copy it out, userspace can scribble on the ring at any time */
+		memcpy(&tmp, &ring->iocbs[idx], sizeof(tmp));
+
+		ret = io_submit_one(ctx, ctx->sq_uiocbs + idx, &tmp, false);
+		if (ret == -EAGAIN)
+			break;
+		if (ret) {
+			ret = aio_complete_error(ctx, ctx->sq_uiocbs + idx,
+						 tmp.aio_data, ret);
+			if (ret)
+				break;
+		}
+		head++;
+		consumed++;
+	}
+	blk_finish_plug(&plug);
+
+	ctx->sq_head = head;
+	smp_store_release(&ring->head, head);
+
+	mutex_unlock(&ctx->sq_lock);
+
+	return consumed ? consumed : ret;
+}
+
+static bool aio_sqring_empty(struct kioctx *ctx)
+{
+	return ctx->sq_head == READ_ONCE(ctx->sq_ring->tail);
+}
+
+/*
+ * The AIO_SQRING_POLL thread: it runs in the mm and with the credentials of
+ * the task that set the ring up, and keeps submitting what userspace queues
+ * until the ring has been idle for ctx->sq_idle. It then sets
+ * AIO_SQRING_NEED_WAKEUP and sleeps until io_submit(ctx, 0) kicks it.
+ * File descriptors are not available here, so only IOCB_FLAG_FIXEDFILE
+ * iocbs can be submitted, and IOCB_FLAG_RESFD is refused with -EINVAL.
+ */
+static int aio_sq_thread(void *data)
+{
+	struct kioctx *ctx = data;
+	struct aio_sqring *ring = ctx->sq_ring;
+	const struct cred *old_cred;
+	unsigned long timeout;
+	mm_segment_t oldfs;
+	DEFINE_WAIT(wait);
+
+	oldfs = get_fs();
+	set_fs(USER_DS);
+	use_mm(ctx->reg_mm);
+	old_cred = override_creds(ctx->sq_creds);
+
+	timeout = jiffies + ctx->sq_idle;
+	while (!kthread_should_stop()) {
+		long ret = aio_sqring_submit(ctx);
+
+		if (ret > 0)
+			timeout = jiffies + ctx->sq_idle;
+		if (ret >= 0 && time_before(jiffies, timeout)) {
+			cond_resched();
+			continue;
+		}
+
+		/*
+		 * Idle, or out of event ring space: go to sleep. The flag has
+		 * to be visible before we look at the ring one last time,
+		 * userspace checks it after advancing ->tail.
+		 */
+		prepare_to_wait(&ctx->sq_wait, &wait, TASK_INTERRUPTIBLE);
+		WRITE_ONCE(ring->flags, ring->flags | AIO_SQRING_NEED_WAKEUP);
+		smp_mb();
+		if ((ret < 0 || aio_sqring_empty(ctx)) &&
+		    !kthread_should_stop())
+			schedule();
+		finish_wait(&ctx->sq_wait, &wait);
+		WRITE_ONCE(ring->flags, ring->flags & ~AIO_SQRING_NEED_WAKEUP);
+
+		timeout = jiffies + ctx->sq_idle;
+	}
+
+	revert_creds(old_cred);
+	unuse_mm(ctx->reg_mm);
+	set_fs(oldfs);
+	return 0;
+}
+
+/* io_submit(ctx, 0, NULL): consume the submission ring, or kick its thread */
+static long aio_sqring_enter(struct kioctx *ctx)
+{
+	/* pairs with the release in aio_register_sqring() */
+	struct aio_sqring *ring = smp_load_acquire(&ctx->sq_ring);
+
+	if (!ring)
+		return 0;
+
+	if (ctx->sq_thread) {
+		smp_mb();
+		if (READ_ONCE(ring->flags) & AIO_SQRING_NEED_WAKEUP)
+			wake_up(&ctx->sq_wait);
+		return 0;
+	}
+
+	return aio_sqring_submit(ctx);
+}
+
 long do_io_submit(aio_context_t ctx_id, long nr,
 		  struct iocb __user *__user *iocbpp, bool compat)
 {
@@ -1583,6 +2172,12 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 		return -EINVAL;
 	}
 
+	if (!nr) {
+		ret = aio_sqring_enter(ctx);
+		percpu_ref_put(&ctx->users);
+		return ret;
+	}
+
 	blk_start_plug(&plug);
 
 	/*
@@ -1631,6 +2226,335 @@ SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 	return do_io_submit(ctx_id, nr, iocbpp, 0);
 }
 
+/*
+ * Registered resources are accounted as pinned memory of the mm that set
+ * them up, against RLIMIT_MEMLOCK unless CAP_IPC_LOCK. Called with
+ * ctx->sq_lock held.
+ */
+static int aio_account_pinned(struct kioctx *ctx, unsigned long nr_pages)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	int ret = 0;
+
+	if (ctx->reg_mm && ctx->reg_mm != mm)
+		return -EINVAL;
+
+	down_write(&mm->mmap_sem);
+	if (mm->pinned_vm + nr_pages > limit && !capable(CAP_IPC_LOCK))
+		ret = -ENOMEM;
+	else
+		mm->pinned_vm += nr_pages;
+	up_write(&mm->mmap_sem);
+
+	if (ret)
+		return ret;
+
+	if (!ctx->reg_mm) {
+		atomic_inc(&mm->mm_count);
+		ctx->reg_mm = mm;
+	}
+	ctx->reg_pinned += nr_pages;
+	return 0;
+}
+
+static int aio_pin_pages(unsigned long start, unsigned long len,
+			 struct page ***pagesp)
+{
+	unsigned long first = start >> PAGE_SHIFT;
+	unsigned long last = (start + len - 1) >> PAGE_SHIFT;
+	int nr_pages = last - first + 1;
+	struct page **pages;
+	int pinned;
+
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL | __GFP_NOWARN);
+	if (!pages)
+		pages = vzalloc(nr_pages * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+
+	pinned = get_user_pages_fast(start & PAGE_MASK, nr_pages, 1, pages);
+	if (pinned != nr_pages) {
+		if (pinned > 0)
+			release_pages(pages, pinned, false);
+		kvfree(pages);
+		return -EFAULT;
+	}
+
+	*pagesp = pages;
+	return nr_pages;
+}
+
+static int aio_register_sqring(struct kioctx *ctx, void __user *arg,
+			       unsigned nr_args)
+{
+	struct aio_sqring_setup p;
+	struct aio_sqring *ring;
+	struct task_struct *thread = NULL;
+	struct page **pages;
+	unsigned long size;
+	void *vaddr;
+	int nr_pages, ret;
+
+	if (nr_args != 1)
+		return -EINVAL;
+	if (copy_from_user(&p, arg, sizeof(p)))
+		return -EFAULT;
+	if (p.flags & ~AIO_SQRING_POLL || p.resv[0] || p.resv[1] || p.resv[2])
+		return -EINVAL;
+	if (!p.entries || p.entries > AIO_SQRING_MAX_ENTRIES ||
+	    !is_power_of_2(p.entries))
+		return -EINVAL;
+	if (p.ring != (unsigned long)p.ring || p.ring % sizeof(u64))
+		return -EINVAL;
+	/* a polling thread burns a CPU on behalf of the caller */
+	if ((p.flags & AIO_SQRING_POLL) && !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	size = sizeof(struct aio_sqring) + p.entries * sizeof(struct iocb);
+	nr_pages = aio_pin_pages(p.ring, size, &pages);
+	if (nr_pages < 0)
+		return nr_pages;
+
+	vaddr = vmap(pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	if (!vaddr) {
+		ret = -ENOMEM;
+		goto err_pages;
+	}
+	ring = vaddr + offset_in_page(p.ring);
+
+	mutex_lock(&ctx->sq_lock);
+	ret = -EBUSY;
+	if (ctx->sq_ring)
+		goto err_unlock;
+	ret = -EINVAL;
+	if (atomic_read(&ctx->dead))
+		goto err_unlock;
+	ret = aio_account_pinned(ctx, nr_pages);
+	if (ret)
+		goto err_unlock;
+
+	ctx->sq_pages = pages;
+	ctx->sq_nr_pages = nr_pages;
+	ctx->sq_uiocbs = (struct iocb __user *)(unsigned long)
+			 (p.ring + offsetof(struct aio_sqring, iocbs));
+	ctx->sq_mask = p.entries - 1;
+	ctx->sq_head = READ_ONCE(ring->head);
+	ring->flags = 0;
+
+	if (p.flags & AIO_SQRING_POLL) {
+		ctx->sq_idle = msecs_to_jiffies(p.idle_ms ? : AIO_SQ_IDLE_MS);
+		ctx->sq_creds = get_current_cred();
+		thread = kthread_create(aio_sq_thread, ctx, "aio-sq/%d",
+					task_pid_nr(current));
+		if (IS_ERR(thread)) {
+			/* free_ioctx() undoes the accounting */
+			ret = PTR_ERR(thread);
+			goto err_unlock;
+		}
+		ctx->sq_thread = thread;
+	}
+
+	/* pairs with the acquire in aio_sqring_enter() */
+	smp_store_release(&ctx->sq_ring, ring);
+	mutex_unlock(&ctx->sq_lock);
+
+	if (thread)
+		wake_up_process(thread);
+	return 0;
+
+err_unlock:
+	mutex_unlock(&ctx->sq_lock);
+	vunmap(vaddr);
+err_pages:
+	release_pages(pages, nr_pages, false);
+	kvfree(pages);
+	return ret;
+}
+
+static int aio_register_buffers(struct kioctx *ctx, void __user *arg,
+				unsigned nr_args)
+{
+	struct iovec __user *uiov = arg;
+	struct aio_mapped_buf *bufs;
+	unsigned long nr_pages = 0;
+	unsigned i, j;
+	int ret;
+
+	if (!nr_args || nr_args > AIO_MAX_FIXED_BUFS)
+		return -EINVAL;
+
+	bufs = kcalloc(nr_args, sizeof(*bufs), GFP_KERNEL);
+	if (!bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_args; i++) {
+		struct iovec iov;
+
+		ret = -EFAULT;
+		if (copy_from_user(&iov, &uiov[i], sizeof(iov)))
+			goto err_free;
+		ret = -EINVAL;
+		if (!iov.iov_len || iov.iov_len > AIO_MAX_FIXED_BUF_SIZE)
+			goto err_free;
+		bufs[i].ubuf = (unsigned long)iov.iov_base;
+		bufs[i].len = iov.iov_len;
+		nr_pages += ((bufs[i].ubuf + bufs[i].len - 1) >> PAGE_SHIFT) -
+			    (bufs[i].ubuf >> PAGE_SHIFT) + 1;
+	}
+
+	mutex_lock(&ctx->sq_lock);
+	ret = -EBUSY;
+	if (ctx->nr_fixed_bufs)
+		goto err_unlock;
+	ret = aio_account_pinned(ctx, nr_pages);
+	if (ret)
+		goto err_unlock;
+
+	for (i = 0; i < nr_args; i++) {
+		struct aio_mapped_buf *buf = &bufs[i];
+		unsigned long off = offset_in_page(buf->ubuf);
+		size_t left = buf->len;
+		struct page **pages;
+		int nr;
+
+		nr = aio_pin_pages(buf->ubuf, buf->len, &pages);
+		if (nr < 0) {
+			ret = nr;
+			goto err_unpin;
+		}
+
+		buf->bvec = kcalloc(nr, sizeof(*buf->bvec),
+				    GFP_KERNEL | __GFP_NOWARN);
+		if (!buf->bvec)
+			buf->bvec = vzalloc(nr * sizeof(*buf->bvec));
+		if (!buf->bvec) {
+			release_pages(pages, nr, false);
+			kvfree(pages);
+			ret = -ENOMEM;
+			goto err_unpin;
+		}
+
+		for (j = 0; j < nr; j++) {
+			size_t n = min_t(size_t, left, PAGE_SIZE - off);
+
+			buf->bvec[j].bv_page = pages[j];
+			buf->bvec[j].bv_offset = off;
+			buf->bvec[j].bv_len = n;
+			left -= n;
+			off = 0;
+		}
+		buf->nr_bvecs = nr;
+		kvfree(pages);
+	}
+
+	ctx->fixed_bufs = bufs;
+	/* pairs with the acquire in aio_fixed_buf() */
+	smp_store_release(&ctx->nr_fixed_bufs, nr_args);
+	mutex_unlock(&ctx->sq_lock);
+	return 0;
+
+err_unpin:
+	for (i = 0; i < nr_args && bufs[i].bvec; i++) {
+		for (j = 0; j < bufs[i].nr_bvecs; j++)
+			put_page(bufs[i].bvec[j].bv_page);
+		kvfree(bufs[i].bvec);
+	}
+	down_write(&current->mm->mmap_sem);
+	current->mm->pinned_vm -= nr_pages;
+	up_write(&current->mm->mmap_sem);
+	ctx->reg_pinned -= nr_pages;
+err_unlock:
+	mutex_unlock(&ctx->sq_lock);
+err_free:
+	kfree(bufs);
+	return ret;
+}
+
+static int aio_register_files(struct kioctx *ctx, void __user *arg,
+			      unsigned nr_args)
+{
+	__s32 __user *fds = arg;
+	struct file **files;
+	unsigned i;
+	int ret;
+
+	if (!nr_args || nr_args > AIO_MAX_FIXED_FILES)
+		return -EINVAL;
+
+	files = kcalloc(nr_args, sizeof(*files), GFP_KERNEL);
+	if (!files)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_args; i++) {
+		__s32 fd;
+
+		ret = -EFAULT;
+		if (get_user(fd, &fds[i]))
+			goto err_put;
+		ret = -EBADF;
+		files[i] = fget(fd);
+		if (!files[i])
+			goto err_put;
+	}
+
+	mutex_lock(&ctx->sq_lock);
+	ret = -EBUSY;
+	if (ctx->nr_fixed_files) {
+		mutex_unlock(&ctx->sq_lock);
+		goto err_put;
+	}
+	ctx->fixed_files = files;
+	/* pairs with the acquire in aio_fixed_file() */
+	smp_store_release(&ctx->nr_fixed_files, nr_args);
+	mutex_unlock(&ctx->sq_lock);
+	return 0;
+
+err_put:
+	while (i--)
+		fput(files[i]);
+	kfree(files);
+	return ret;
+}
+
+/* sys_io_register:
+ *	Sets up the submission ring (AIO_REGISTER_SQRING), or registers
+ *	buffers (AIO_REGISTER_BUFFERS) or files (AIO_REGISTER_FILES) that
+ *	iocbs can then refer to by index without having them pinned or
+ *	looked up on every submission. Each can be registered once, and
+ *	stays registered until the context is destroyed. Returns 0 on
+ *	success, -EBUSY if already registered, -EINVAL for an invalid
+ *	context or argument, -EFAULT, -EBADF, -ENOMEM or -EPERM.
+ */
+SYSCALL_DEFINE4(io_register, aio_context_t, ctx_id, unsigned int, opcode,
+		void __user *, arg, unsigned int, nr_args)
+{
+	struct kioctx *ctx;
+	long ret;
+
+	ctx = lookup_ioctx(ctx_id);
+	if (unlikely(!ctx))
+		return -EINVAL;
+
+	switch (opcode) {
+	case AIO_REGISTER_SQRING:
+		ret = aio_register_sqring(ctx, arg, nr_args);
+		break;
+	case AIO_REGISTER_BUFFERS:
+		ret = aio_register_buffers(ctx, arg, nr_args);
+		break;
+	case AIO_REGISTER_FILES:
+		ret = aio_register_files(ctx, arg, nr_args);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	percpu_ref_put(&ctx->users);
+	return ret;
+}
+
 /* lookup_kiocb
  *	Finds a given iocb for cancellation.
  */
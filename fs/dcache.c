@@ -118,6 +118,13 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * Maximum number of negative dentries kept on the LRU list of each
+ * superblock, zero for no limit.  Set up in dcache_init().
+ */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -151,11 +158,21 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -269,26 +286,68 @@ static inline int dname_external(const struct dentry *dentry)
 	return dentry->d_name.name != dentry->d_iname;
 }
 
+/*
+ * Negative dentries on a superblock LRU list (not on a shrink list) are
+ * counted globally for dentry-state and per superblock in
+ * s_nr_dentry_negative.  When a superblock goes over its budget of them,
+ * trim_negative_dentries() gets to throw the oldest ones out instead of
+ * leaving them all to the shrinker.  d_lock must be held by the caller.
+ */
+static void trim_negative_dentries(struct work_struct *work);
+static DECLARE_WORK(negative_dentry_trim_work, trim_negative_dentries);
+
+static inline bool d_negative_on_lru(const struct dentry *dentry)
+{
+	return d_is_negative(dentry) &&
+	       (dentry->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) ==
+			DCACHE_LRU_LIST;
+}
+
+static void d_negative_inc(struct dentry *dentry)
+{
+	struct percpu_counter *nr = &dentry->d_sb->s_nr_dentry_negative;
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+
+	this_cpu_inc(nr_dentry_negative);
+	percpu_counter_inc(nr);
+	if (unlikely(limit && percpu_counter_read(nr) > (s64)limit) &&
+	    !work_pending(&negative_dentry_trim_work))
+		schedule_work(&negative_dentry_trim_work);
+}
+
+static void d_negative_dec(struct dentry *dentry)
+{
+	this_cpu_dec(nr_dentry_negative);
+	percpu_counter_dec(&dentry->d_sb->s_nr_dentry_negative);
+}
+
 static inline void __d_set_inode_and_type(struct dentry *dentry,
 					  struct inode *inode,
 					  unsigned type_flags)
 {
 	unsigned flags;
 
+	if (d_negative_on_lru(dentry))
+		d_negative_dec(dentry);
 	dentry->d_inode = inode;
 	flags = READ_ONCE(dentry->d_flags);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	flags |= type_flags;
 	WRITE_ONCE(dentry->d_flags, flags);
+	if (d_negative_on_lru(dentry))
+		d_negative_inc(dentry);
 }
 
 static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
+	bool was_negative = d_negative_on_lru(dentry);
 
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
+	if (!was_negative && d_negative_on_lru(dentry))
+		d_negative_inc(dentry);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -392,12 +451,16 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_inc(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
 static void d_lru_del(struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
+	if (d_is_negative(dentry))
+		d_negative_dec(dentry);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
@@ -428,6 +491,8 @@ static void d_shrink_add(struct dentry *dentry, struct list_head *list)
 static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
+	if (d_is_negative(dentry))
+		d_negative_dec(dentry);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	list_lru_isolate(lru, &dentry->d_lru);
@@ -437,6 +502,8 @@ static void d_lru_shrink_move(struct list_lru_one *lru, struct dentry *dentry,
 			      struct list_head *list)
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
+	if (d_is_negative(dentry))
+		d_negative_dec(dentry);
 	dentry->d_flags |= DCACHE_SHRINK_LIST;
 	list_lru_isolate_move(lru, &dentry->d_lru, list);
 }
@@ -1133,6 +1200,77 @@ void shrink_dcache_sb(struct super_block *sb)
 }
 EXPORT_SYMBOL(shrink_dcache_sb);
 
+static enum lru_status dentry_negative_lru_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	/*
+	 * Positive dentries are left for the shrinker.  Rotating them gives
+	 * them no more than DCACHE_REFERENCED gets in dentry_lru_isolate(),
+	 * and keeps the next batch from walking over them again.  Negative
+	 * dentries which were looked up since the last pass get another one.
+	 */
+	if (!d_is_negative(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+	if (dentry->d_flags & DCACHE_REFERENCED) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+#define NEGATIVE_TRIM_BATCH	1024UL
+
+/*
+ * Bring the negative dentries of @sb back to 7/8 of the limit, going over
+ * its LRU list at most once, a batch at a time so that the LRU lock is not
+ * held for long.
+ */
+static void trim_negative_dentries_sb(struct super_block *sb, void *arg)
+{
+	unsigned long limit = *(unsigned long *)arg;
+	s64 target = limit - limit / 8;
+	unsigned long nr_to_walk = list_lru_count(&sb->s_dentry_lru);
+
+	while (nr_to_walk &&
+	       percpu_counter_read_positive(&sb->s_nr_dentry_negative) > target) {
+		unsigned long nr = min(nr_to_walk, NEGATIVE_TRIM_BATCH);
+		LIST_HEAD(dispose);
+
+		list_lru_walk(&sb->s_dentry_lru, dentry_negative_lru_isolate,
+			      &dispose, nr);
+		shrink_dentry_list(&dispose);
+		nr_to_walk -= nr;
+		cond_resched();
+	}
+}
+
+static void trim_negative_dentries(struct work_struct *work)
+{
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+
+	if (limit)
+		iterate_supers(trim_negative_dentries_sb, &limit);
+}
+
 /**
  * enum d_walk_ret - action to talke during tree walk
  * @D_WALK_CONTINUE:	contrinue walk
@@ -3412,6 +3550,10 @@ static void __init dcache_init(void)
 	dentry_cache = KMEM_CACHE(dentry,
 		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD);
 
+	/* Negative dentries of one superblock may take about 2% of memory */
+	sysctl_negative_dentry_limit = totalram_pages / 50 *
+				       (PAGE_SIZE / sizeof(struct dentry));
+
 	/* Hash may have been set up in dcache_init_early */
 	if (!hashdist)
 		return;
@@ -3450,6 +3592,7 @@ void __init vfs_caches_init(void)
 
 	dcache_init();
 	inode_init();
+	lookup_locks_init();
 	files_init();
 	files_maxfiles_init();
 	mnt_init();
@@ -42,21 +42,23 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/llist.h>
+#include <net/busy_poll.h>
 
 /*
  * LOCKING:
- * There are three level of locking required by epoll :
+ * There are two level of locking required by epoll :
  *
  * 1) epmutex (mutex)
  * 2) ep->mtx (mutex)
- * 3) ep->lock (spinlock)
  *
- * The acquire order is the one listed above, from 1 to 3.
- * We need a spinlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * The acquire order is the one listed above, from 1 to 2.
+ * The poll callback might be triggered from a wake_up() that in turn
+ * might be called from IRQ context, so it can neither sleep nor take
+ * ep->mtx. Instead of sharing a lock with the consumer, the callback
+ * pushes ready items onto a lock-less list (ep->rdlhead), and whoever
+ * holds ep->mtx moves them onto ep->rdllist, which is only ever touched
+ * with ep->mtx held. During the event transfer loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -84,7 +86,7 @@
  * of epoll file descriptors, we use the current recursion depth as
  * the lockdep subkey.
  * It is possible to drop the "ep->mtx" and to use the global
- * mutex "epmutex" (together with "ep->lock") to have it working,
+ * mutex "epmutex" to have it working,
  * but having "ep->mtx" will make the interface more scalable.
  * Events that require holding "epmutex" are very rare, while for
  * normal operations the epoll private "ep->mtx" will guarantee
@@ -92,13 +94,23 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | \
+			 EPOLLEXCLUSIVE | EPOLLROUNDROBIN)
+
+#define EPOLLINOUT_BITS (POLLIN | POLLOUT)
+
+#define EPOLLEXCLUSIVE_OK_BITS (EPOLLINOUT_BITS | POLLERR | POLLHUP | \
+				EPOLLWAKEUP | EPOLLET | EPOLLEXCLUSIVE | \
+				EPOLLROUNDROBIN)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
+/* Maximum number of commands accepted by one epoll_ctl_batch() call */
+#define EP_MAX_BATCH 1024
+
 #define EP_UNACTIVE_PTR ((void *) -1L)
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
@@ -145,10 +157,10 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links this structure to the "struct eventpoll"->rdlhead lock-less
+	 * list. ->next is EP_UNACTIVE_PTR while the item is not queued there.
 	 */
-	struct epitem *next;
+	struct llist_node rdlnode;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -178,9 +190,6 @@ struct epitem {
  * interface.
  */
 struct eventpoll {
-	/* Protect the access to this structure */
-	spinlock_t lock;
-
 	/*
 	 * This mutex is used to ensure that files are not removed
 	 * while epoll is using them. This is held during the event
@@ -195,18 +204,18 @@ struct eventpoll {
 	/* Wait queue used by file->poll() */
 	wait_queue_head_t poll_wait;
 
-	/* List of ready file descriptors */
+	/* List of ready file descriptors, protected by "mtx" */
 	struct list_head rdllist;
 
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Lock-less list of the "struct epitem" signalled by the poll callback.
+	 * It is drained into ->rdllist by whoever holds "mtx", so wakeups never
+	 * contend with the transfer of ready events to userspace.
 	 */
-	struct epitem *ovflist;
+	struct llist_head rdlhead;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
@@ -219,6 +228,11 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* used to track busy poll napi_id */
+	unsigned int napi_id;
+#endif
 };
 
 /* Wait structure used by the poll hooks */
@@ -376,9 +390,88 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	return !list_empty(&ep->rdllist) || !llist_empty(&ep->rdlhead);
+}
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static bool ep_busy_loop_end(void *p)
+{
+	struct eventpoll *ep = p;
+
+	return ep_events_available(ep);
+}
+
+/*
+ * Busy poll if globally on and supporting sockets found && no events,
+ * busy loop will return if need_resched or ep_events_available.
+ *
+ * we must do our busy polling with irqs enabled
+ */
+static bool ep_busy_loop(struct eventpoll *ep)
+{
+	unsigned int napi_id = READ_ONCE(ep->napi_id);
+
+	if (napi_id && net_busy_loop_on())
+		return napi_busy_loop(napi_id, false, busy_loop_end_time(),
+				      ep_busy_loop_end, ep);
+	return false;
 }
 
+static inline void ep_reset_busy_poll_napi_id(struct eventpoll *ep)
+{
+	if (ep->napi_id)
+		ep->napi_id = 0;
+}
+
+/*
+ * Set epoll busy poll NAPI ID from sk.  The eventpoll remembers the NAPI
+ * context of the socket that most recently became ready, which for the
+ * usual one-queue-per-thread setups is the one the next event comes from.
+ */
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+	struct eventpoll *ep;
+	unsigned int napi_id;
+	struct socket *sock;
+	struct sock *sk;
+	int err;
+
+	if (!net_busy_loop_on())
+		return;
+
+	sock = sock_from_file(epi->ffd.file, &err);
+	if (!sock)
+		return;
+
+	sk = sock->sk;
+	if (!sk)
+		return;
+
+	napi_id = READ_ONCE(sk->sk_napi_id);
+	ep = epi->ep;
+
+	/* Nothing to do if there is no NAPI ID or we already have it */
+	if (!napi_id || napi_id == ep->napi_id)
+		return;
+
+	/* record NAPI ID for use in next busy poll */
+	ep->napi_id = napi_id;
+}
+#else
+static inline bool ep_busy_loop(struct eventpoll *ep)
+{
+	return false;
+}
+
+static inline void ep_reset_busy_poll_napi_id(struct eventpoll *ep)
+{
+}
+
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 /**
  * ep_call_nested - Perform a bound (possibly) nested call, by checking
  *                  that the recursion limit is not exceeded, and that
@@ -518,8 +611,12 @@ static void ep_remove_wait_queue(struct eppoll_entry *pwq)
 	wait_queue_head_t *whead;
 
 	rcu_read_lock();
-	/* If it is cleared by POLLFREE, it should be rcu-safe */
-	whead = rcu_dereference(pwq->whead);
+	/*
+	 * If it is cleared by POLLFREE, it should be rcu-safe. The acquire
+	 * pairs with the release in ep_poll_callback(): once we see NULL, the
+	 * callback is done with the item and our caller may free it.
+	 */
+	whead = smp_load_acquire(&pwq->whead);
 	if (whead)
 		remove_wait_queue(whead, &pwq->wait);
 	rcu_read_unlock();
@@ -576,6 +673,66 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+/*
+ * Moves the items queued by ep_poll_callback() on ep->rdlhead onto
+ * ep->rdllist, in the order they were signalled. Must be called with
+ * "mtx" held.
+ */
+static void ep_flush_ready(struct eventpoll *ep)
+{
+	struct llist_node *node, *next;
+	struct epitem *epi;
+
+	node = llist_del_all(&ep->rdlhead);
+	if (!node)
+		return;
+
+	for (node = llist_reverse_order(node); node; node = next) {
+		epi = llist_entry(node, struct epitem, rdlnode);
+
+		/*
+		 * Mark the item as no longer queued, so that an event arriving
+		 * from now on queues it again. The xchg() makes sure we read
+		 * ->next before the poll callback can reuse it.
+		 */
+		next = xchg(&node->next, EP_UNACTIVE_PTR);
+		if (!ep_is_linked(&epi->rdllink)) {
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+			ep_pm_stay_awake(epi);
+		}
+	}
+}
+
+/*
+ * Unlinks @epi from the ready list, once the poll callback can no longer hit
+ * it. Must be called with "mtx" held.
+ */
+static void ep_unlink_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	if (READ_ONCE(epi->rdlnode.next) != EP_UNACTIVE_PTR)
+		ep_flush_ready(ep);
+	if (ep_is_linked(&epi->rdllink))
+		list_del_init(&epi->rdllink);
+}
+
+/*
+ * Wakes up the epoll_wait() callers after items have been added to
+ * ep->rdllist. Returns non-zero if the ->poll() wait list needs a wakeup,
+ * which the caller has to do via ep_poll_safewake().
+ */
+static int ep_wake_ready(struct eventpoll *ep)
+{
+	/*
+	 * Pairs with set_current_state() in ep_poll(): either the waiter sees
+	 * the new ready items, or we see the waiter.
+	 */
+	smp_mb();
+	if (waitqueue_active(&ep->wq))
+		wake_up(&ep->wq);
+
+	return waitqueue_active(&ep->poll_wait);
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -595,8 +752,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 			      void *priv, int depth, bool ep_locked)
 {
 	int error, pwake = 0;
-	unsigned long flags;
-	struct epitem *epi, *nepi;
 	LIST_HEAD(txlist);
 
 	/*
@@ -608,66 +763,29 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		mutex_lock_nested(&ep->mtx, depth);
 
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * Pull in the items queued by the poll callback since the last scan,
+	 * then steal the ready list. Nobody but the "mtx" holder touches
+	 * ep->rdllist, so the "sproc" callback can re-queue items on it
+	 * without any lock, while the poll callback keeps feeding
+	 * ep->rdlhead in the meantime.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
+	ep_flush_ready(ep);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
-	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
 	 * Now call the callback function.
 	 */
 	error = (*sproc)(ep, &txlist, priv);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	/*
-	 * During the time we spent inside the "sproc" callback, some
-	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
-	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
-
 	/*
-	 * Quickly re-inject items left on "txlist".
+	 * Quickly re-inject items left on "txlist". Items signalled while
+	 * "sproc" was running stay on ep->rdlhead until the next scan.
 	 */
 	list_splice(&txlist, &ep->rdllist);
 	__pm_relax(ep->ws);
 
-	if (!list_empty(&ep->rdllist)) {
-		/*
-		 * Wake up (if active) both the eventpoll wait list and
-		 * the ->poll() wait list (delayed after we release the lock).
-		 */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
-		if (waitqueue_active(&ep->poll_wait))
-			pwake++;
-	}
-	spin_unlock_irqrestore(&ep->lock, flags);
+	if (ep_events_available(ep))
+		pwake = ep_wake_ready(ep);
 
 	if (!ep_locked)
 		mutex_unlock(&ep->mtx);
@@ -691,16 +809,12 @@ static void epi_rcu_free(struct rcu_head *head)
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
-	 * Removes poll wait queue hooks. We _have_ to do this without holding
-	 * the "ep->lock" otherwise a deadlock might occur. This because of the
-	 * sequence of the lock acquisition. Here we do "ep->lock" then the wait
-	 * queue head lock when unregistering the wait queue. The wakeup callback
-	 * will run by holding the wait queue head lock and will call our callback
-	 * that will try to get "ep->lock".
+	 * Removes poll wait queue hooks. The wakeup callback runs holding the
+	 * wait queue head lock, so once this returns the item can no longer be
+	 * queued on ep->rdlhead.
 	 */
 	ep_unregister_pollwait(ep, epi);
 
@@ -711,10 +825,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 	/*
@@ -764,9 +875,8 @@ static void ep_free(struct eventpoll *ep)
 	 * Walks through the whole tree by freeing each "struct epitem". At this
 	 * point we are sure no poll callbacks will be lingering around, and also by
 	 * holding "epmutex" we can be sure that no file cleanup code will hit
-	 * us during this operation. So we can avoid the lock on "ep->lock".
-	 * We do not need to lock ep->mtx, either, we only do it to prevent
-	 * a lockdep warning.
+	 * us during this operation. We do not need to lock ep->mtx, either,
+	 * we only do it to prevent a lockdep warning.
 	 */
 	mutex_lock(&ep->mtx);
 	while ((rbp = rb_first(&ep->rbr)) != NULL) {
@@ -944,13 +1054,12 @@ static int ep_alloc(struct eventpoll **pep)
 	if (unlikely(!ep))
 		goto free_uid;
 
-	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
+	init_llist_head(&ep->rdlhead);
 	ep->user = user;
 
 	*pep = ep;
@@ -998,23 +1107,9 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
-	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
-
-	if ((unsigned long)key & POLLFREE) {
-		ep_pwq_from_wait(wait)->whead = NULL;
-		/*
-		 * whead = NULL above can race with ep_remove_wait_queue()
-		 * which can do another remove_wait_queue() after us, so we
-		 * can't use __remove_wait_queue(). whead->lock is held by
-		 * the caller.
-		 */
-		list_del_init(&wait->task_list);
-	}
-
-	spin_lock_irqsave(&ep->lock, flags);
+	int ewake = 0;
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
@@ -1023,7 +1118,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -1032,53 +1127,67 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
+		goto out;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Queue the item on the lock-less ready list unless it is already
+	 * there. We take no lock shared with the consumer: whoever holds
+	 * "mtx" moves the item onto ep->rdllist, skipping it if it is
+	 * already linked there.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-			if (epi->ws) {
-				/*
-				 * Activate ep->ws since epi->ws may get
-				 * deactivated at any time.
-				 */
-				__pm_stay_awake(ep->ws);
-			}
-
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink)) {
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (cmpxchg(&epi->rdlnode.next, EP_UNACTIVE_PTR, NULL) ==
+	    EP_UNACTIVE_PTR) {
+		llist_add(&epi->rdlnode, &ep->rdlhead);
 		ep_pm_stay_awake_rcu(epi);
 	}
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. llist_add() implies a full barrier, which pairs with
+	 * set_current_state() in ep_poll().
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->wq)) {
+		ewake = 1;
+		wake_up(&ep->wq);
+	}
 	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
+		ep_poll_safewake(&ep->poll_wait);
 
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
+out:
+	/*
+	 * For an exclusive entry, report whether a waiter was actually woken
+	 * up: if nobody was sleeping on this epoll instance, the wakeup moves
+	 * on to the next exclusive entry of the source. With EPOLLROUNDROBIN
+	 * the entry that consumed the wakeup is then moved to the tail of the
+	 * source's wait queue by __wake_up_common(), once it is done walking
+	 * it, so the next event goes to another instance.
+	 */
+	if (!(epi->event.events & EPOLLEXCLUSIVE))
+		ewake = 1;
 
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	if ((unsigned long)key & POLLFREE) {
+		/*
+		 * If we race with ep_remove_wait_queue() it can miss
+		 * ->whead = NULL and do another remove_wait_queue() after
+		 * us, so we can't use __remove_wait_queue(). whead->lock is
+		 * held by the caller.
+		 */
+		list_del_init(&wait->task_list);
+		/*
+		 * Every entry has to unhook itself, so this one must not use
+		 * up an exclusive wakeup. Nor may the caller rotate it: it is
+		 * off the list and may be freed as soon as ->whead is cleared.
+		 */
+		ewake = 0;
+		/*
+		 * ->whead != NULL is what keeps ep_remove() from freeing the
+		 * item under us, now that no lock is shared with it: clear it
+		 * only once we are done touching epi.
+		 */
+		smp_store_release(&ep_pwq_from_wait(wait)->whead, NULL);
+	}
 
-	return 1;
+	return ewake;
 }
 
 /*
@@ -1095,7 +1204,12 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLROUNDROBIN)
+			pwq->wait.flags |= WQ_FLAG_ROUNDROBIN;
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1265,7 +1379,6 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 		     struct file *tfile, int fd, int full_check)
 {
 	int error, revents, pwake = 0;
-	unsigned long flags;
 	long user_watches;
 	struct epitem *epi;
 	struct ep_pqueue epq;
@@ -1284,7 +1397,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->rdlnode.next = EP_UNACTIVE_PTR;
 	if (epi->event.events & EPOLLWAKEUP) {
 		error = ep_create_wakeup_source(epi);
 		if (error)
@@ -1331,25 +1444,19 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	if (full_check && reverse_path_check())
 		goto error_remove_epi;
 
-	/* We have to drop the new item inside our item list to keep track of it */
-	spin_lock_irqsave(&ep->lock, flags);
-
 	/* If the file is already "ready" we drop it inside the ready list */
 	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 		ep_pm_stay_awake(epi);
 
 		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
-		if (waitqueue_active(&ep->poll_wait))
-			pwake++;
+		pwake = ep_wake_ready(ep);
 	}
 
-	spin_unlock_irqrestore(&ep->lock, flags);
-
 	atomic_long_inc(&ep->user->epoll_watches);
 
+	ep_set_busy_poll_napi_id(epi);
+
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
@@ -1368,14 +1475,10 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue. The ready lists are only drained inside a
+	 * section bound by "mtx", and ep_insert() is called with "mtx" held.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 
@@ -1417,9 +1520,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * 1) Flush epi changes above to other CPUs.  This ensures
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
-	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    We need this because ep_poll_callback() looks at
+	 *    epi->event.events without taking any lock.
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1441,19 +1543,12 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * If the item is "hot" and it is not registered inside the ready
 	 * list, push it inside.
 	 */
-	if (revents & event->events) {
-		spin_lock_irq(&ep->lock);
-		if (!ep_is_linked(&epi->rdllink)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
+	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
+		list_add_tail(&epi->rdllink, &ep->rdllist);
+		ep_pm_stay_awake(epi);
 
-			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
-			if (waitqueue_active(&ep->poll_wait))
-				pwake++;
-		}
-		spin_unlock_irq(&ep->lock);
+		/* Notify waiting tasks that events are available */
+		pwake = ep_wake_ready(ep);
 	}
 
 	/* We have to call this outside the lock */
@@ -1512,6 +1607,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		 * can change the item.
 		 */
 		if (revents) {
+			ep_set_busy_poll_napi_id(epi);
 			if (__put_user(revents, &uevent->events) ||
 			    __put_user(epi->event.data, &uevent->data)) {
 				list_add(&epi->rdllink, head);
@@ -1532,7 +1628,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback only queues on ep->rdlhead.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 				ep_pm_stay_awake(epi);
@@ -1586,7 +1682,6 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		   int maxevents, long timeout)
 {
 	int res = 0, eavail, timed_out = 0;
-	unsigned long flags;
 	long slack = 0;
 	wait_queue_t wait;
 	ktime_t expires, *to = NULL;
@@ -1603,21 +1698,29 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 * caller specified a non blocking operation.
 		 */
 		timed_out = 1;
-		spin_lock_irqsave(&ep->lock, flags);
 		goto check_events;
 	}
 
 fetch_events:
-	spin_lock_irqsave(&ep->lock, flags);
+
+	if (!ep_events_available(ep))
+		ep_busy_loop(ep);
 
 	if (!ep_events_available(ep)) {
+		/*
+		 * Busy poll timed out.  Drop NAPI ID for now, we can add
+		 * it back in when we have moved a socket with a valid NAPI
+		 * ID onto the ready list.
+		 */
+		ep_reset_busy_poll_napi_id(ep);
+
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
 		 * ep_poll_callback() when events will become available.
 		 */
 		init_waitqueue_entry(&wait, current);
-		__add_wait_queue_exclusive(&ep->wq, &wait);
+		add_wait_queue_exclusive(&ep->wq, &wait);
 
 		for (;;) {
 			/*
@@ -1633,22 +1736,17 @@ fetch_events:
 				break;
 			}
 
-			spin_unlock_irqrestore(&ep->lock, flags);
 			if (!schedule_hrtimeout_range(to, slack, HRTIMER_MODE_ABS))
 				timed_out = 1;
-
-			spin_lock_irqsave(&ep->lock, flags);
 		}
 
-		__remove_wait_queue(&ep->wq, &wait);
 		__set_current_state(TASK_RUNNING);
+		remove_wait_queue(&ep->wq, &wait);
 	}
 check_events:
 	/* Is it worth to try to dig for events ? */
 	eavail = ep_events_available(ep);
 
-	spin_unlock_irqrestore(&ep->lock, flags);
-
 	/*
 	 * Try to transfer events to user space. In case we get 0 events and
 	 * there's still timeout left over, we go trying again in search of
@@ -1813,112 +1911,81 @@ SYSCALL_DEFINE1(epoll_create, int, size)
 }
 
 /*
- * The following function implements the controller interface for
- * the eventpoll file that enables the insertion/removal/change of
- * file descriptors inside the interest set.
+ * Sanity checks shared by epoll_ctl() and epoll_ctl_batch(), done before
+ * the interest list is touched.
  */
-SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
-		struct epoll_event __user *, event)
+static int ep_ctl_check(struct file *file, struct file *tfile, int op,
+			struct epoll_event *epds)
 {
-	int error;
-	int full_check = 0;
-	struct fd f, tf;
-	struct eventpoll *ep;
-	struct epitem *epi;
-	struct epoll_event epds;
-	struct eventpoll *tep = NULL;
-
-	error = -EFAULT;
-	if (ep_op_has_event(op) &&
-	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
-		goto error_return;
-
-	error = -EBADF;
-	f = fdget(epfd);
-	if (!f.file)
-		goto error_return;
-
-	/* Get the "struct file *" for the target file */
-	tf = fdget(fd);
-	if (!tf.file)
-		goto error_fput;
-
 	/* The target file descriptor must support poll */
-	error = -EPERM;
-	if (!tf.file->f_op->poll)
-		goto error_tgt_fput;
+	if (!tfile->f_op->poll)
+		return -EPERM;
 
 	/* Check if EPOLLWAKEUP is allowed */
 	if (ep_op_has_event(op))
-		ep_take_care_of_epollwakeup(&epds);
+		ep_take_care_of_epollwakeup(epds);
 
 	/*
 	 * We have to check that the file structure underneath the file descriptor
 	 * the user passed to us _is_ an eventpoll file. And also we do not permit
 	 * adding an epoll file descriptor inside itself.
 	 */
-	error = -EINVAL;
-	if (f.file == tf.file || !is_file_epoll(f.file))
-		goto error_tgt_fput;
+	if (file == tfile || !is_file_epoll(file))
+		return -EINVAL;
 
 	/*
-	 * At this point it is safe to assume that the "private_data" contains
-	 * our own data structure.
+	 * epoll adds to the wakeup queue at EPOLL_CTL_ADD time only,
+	 * so EPOLLEXCLUSIVE is not allowed for a EPOLL_CTL_MOD operation.
+	 * Also, we do not currently support nested exclusive wakeups.
 	 */
-	ep = f.file->private_data;
-
-	/*
-	 * When we insert an epoll file descriptor, inside another epoll file
-	 * descriptor, there is the change of creating closed loops, which are
-	 * better be handled here, than in more critical paths. While we are
-	 * checking for loops we also determine the list of files reachable
-	 * and hang them on the tfile_check_list, so we can check that we
-	 * haven't created too many possible wakeup paths.
-	 *
-	 * We do not need to take the global 'epumutex' on EPOLL_CTL_ADD when
-	 * the epoll file descriptor is attaching directly to a wakeup source,
-	 * unless the epoll file descriptor is nested. The purpose of taking the
-	 * 'epmutex' on add is to prevent complex toplogies such as loops and
-	 * deep wakeup paths from forming in parallel through multiple
-	 * EPOLL_CTL_ADD operations.
-	 */
-	mutex_lock_nested(&ep->mtx, 0);
-	if (op == EPOLL_CTL_ADD) {
-		if (!list_empty(&f.file->f_ep_links) ||
-						is_file_epoll(tf.file)) {
-			full_check = 1;
-			mutex_unlock(&ep->mtx);
-			mutex_lock(&epmutex);
-			if (is_file_epoll(tf.file)) {
-				error = -ELOOP;
-				if (ep_loop_check(ep, tf.file) != 0) {
-					clear_tfile_check_list();
-					goto error_tgt_fput;
-				}
-			} else
-				list_add(&tf.file->f_tfile_llink,
-							&tfile_check_list);
-			mutex_lock_nested(&ep->mtx, 0);
-			if (is_file_epoll(tf.file)) {
-				tep = tf.file->private_data;
-				mutex_lock_nested(&tep->mtx, 1);
-			}
-		}
+	if (ep_op_has_event(op) &&
+	    (epds->events & (EPOLLEXCLUSIVE | EPOLLROUNDROBIN))) {
+		if (op == EPOLL_CTL_MOD)
+			return -EINVAL;
+		if (is_file_epoll(tfile) ||
+		    !(epds->events & EPOLLEXCLUSIVE) ||
+		    (epds->events & ~EPOLLEXCLUSIVE_OK_BITS))
+			return -EINVAL;
 	}
 
+	return 0;
+}
+
+/*
+ * An EPOLL_CTL_ADD needs the global loop and wakeup path checks, done
+ * under "epmutex", if the epoll file is itself watched by another epoll
+ * file or if the target is an epoll file.
+ */
+static inline int ep_ctl_needs_full_check(struct file *file,
+					  struct file *tfile, int op)
+{
+	return op == EPOLL_CTL_ADD &&
+	       (!list_empty(&file->f_ep_links) || is_file_epoll(tfile));
+}
+
+/*
+ * Apply a single operation to the interest list. Must be called with
+ * "mtx" held.
+ */
+static int ep_ctl_locked(struct eventpoll *ep, int op, struct file *tfile,
+			 int fd, struct epoll_event *epds, int full_check)
+{
+	struct epitem *epi;
+	int error;
+
 	/*
 	 * Try to lookup the file inside our RB tree, Since we grabbed "mtx"
 	 * above, we can be sure to be able to use the item looked up by
 	 * ep_find() till we release the mutex.
 	 */
-	epi = ep_find(ep, tf.file, fd);
+	epi = ep_find(ep, tfile, fd);
 
 	error = -EINVAL;
 	switch (op) {
 	case EPOLL_CTL_ADD:
 		if (!epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_insert(ep, &epds, tf.file, fd, full_check);
+			epds->events |= POLLERR | POLLHUP;
+			error = ep_insert(ep, epds, tfile, fd, full_check);
 		} else
 			error = -EEXIST;
 		if (full_check)
@@ -1932,20 +1999,117 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds->events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
 	}
+
+	return error;
+}
+
+/*
+ * Body of epoll_ctl(): checks the request, takes the locks it needs and
+ * applies it.  "file" is the epoll file and "tfile" the target file.
+ */
+static int ep_ctl(struct file *file, struct file *tfile, int fd, int op,
+		  struct epoll_event *epds)
+{
+	int error;
+	int full_check = 0;
+	struct eventpoll *ep;
+	struct eventpoll *tep = NULL;
+
+	error = ep_ctl_check(file, tfile, op, epds);
+	if (error)
+		return error;
+
+	/*
+	 * At this point it is safe to assume that the "private_data" contains
+	 * our own data structure.
+	 */
+	ep = file->private_data;
+
+	/*
+	 * When we insert an epoll file descriptor, inside another epoll file
+	 * descriptor, there is the change of creating closed loops, which are
+	 * better be handled here, than in more critical paths. While we are
+	 * checking for loops we also determine the list of files reachable
+	 * and hang them on the tfile_check_list, so we can check that we
+	 * haven't created too many possible wakeup paths.
+	 *
+	 * We do not need to take the global 'epumutex' on EPOLL_CTL_ADD when
+	 * the epoll file descriptor is attaching directly to a wakeup source,
+	 * unless the epoll file descriptor is nested. The purpose of taking the
+	 * 'epmutex' on add is to prevent complex toplogies such as loops and
+	 * deep wakeup paths from forming in parallel through multiple
+	 * EPOLL_CTL_ADD operations.
+	 */
+	mutex_lock_nested(&ep->mtx, 0);
+	if (ep_ctl_needs_full_check(file, tfile, op)) {
+		full_check = 1;
+		mutex_unlock(&ep->mtx);
+		mutex_lock(&epmutex);
+		if (is_file_epoll(tfile)) {
+			error = -ELOOP;
+			if (ep_loop_check(ep, tfile) != 0) {
+				clear_tfile_check_list();
+				goto error_unlock;
+			}
+		} else
+			list_add(&tfile->f_tfile_llink, &tfile_check_list);
+		mutex_lock_nested(&ep->mtx, 0);
+		if (is_file_epoll(tfile)) {
+			tep = tfile->private_data;
+			mutex_lock_nested(&tep->mtx, 1);
+		}
+	}
+
+	error = ep_ctl_locked(ep, op, tfile, fd, epds, full_check);
+
 	if (tep != NULL)
 		mutex_unlock(&tep->mtx);
 	mutex_unlock(&ep->mtx);
 
-error_tgt_fput:
+error_unlock:
 	if (full_check)
 		mutex_unlock(&epmutex);
 
+	return error;
+}
+
+/*
+ * The following function implements the controller interface for
+ * the eventpoll file that enables the insertion/removal/change of
+ * file descriptors inside the interest set.
+ */
+SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
+		struct epoll_event __user *, event)
+{
+	int error;
+	struct fd f, tf;
+	struct epoll_event epds;
+
+	error = -EFAULT;
+	if (ep_op_has_event(op) &&
+	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
+		goto error_return;
+
+	error = -EBADF;
+	f = fdget(epfd);
+	if (!f.file)
+		goto error_return;
+
+	/* Get the "struct file *" for the target file */
+	tf = fdget(fd);
+	if (!tf.file)
+		goto error_fput;
+
+	error = ep_ctl(f.file, tf.file, fd, op, &epds);
+
 	fdput(tf);
 error_fput:
 	fdput(f);
@@ -1954,6 +2118,88 @@ error_return:
 	return error;
 }
 
+/*
+ * Vectored epoll_ctl(): applies up to EP_MAX_BATCH operations taking
+ * ep->mtx only once, which makes re-arming many EPOLLONESHOT descriptors
+ * considerably cheaper.  The outcome of each command is stored in its
+ * "result" field and the array is copied back to user space.  Returns
+ * the number of commands processed.
+ */
+SYSCALL_DEFINE4(epoll_ctl_batch, int, epfd, int, flags,
+		int, ncmds, struct epoll_ctl_cmd __user *, cmds)
+{
+	int i, error;
+	size_t size;
+	struct fd f;
+	struct eventpoll *ep;
+	struct epoll_ctl_cmd *kcmds;
+
+	if (flags || ncmds <= 0 || ncmds > EP_MAX_BATCH)
+		return -EINVAL;
+
+	size = ncmds * sizeof(struct epoll_ctl_cmd);
+	kcmds = memdup_user(cmds, size);
+	if (IS_ERR(kcmds))
+		return PTR_ERR(kcmds);
+
+	error = -EBADF;
+	f = fdget(epfd);
+	if (!f.file)
+		goto error_free;
+
+	error = -EINVAL;
+	if (!is_file_epoll(f.file))
+		goto error_fput;
+	ep = f.file->private_data;
+
+	mutex_lock_nested(&ep->mtx, 0);
+	for (i = 0; i < ncmds; i++) {
+		struct epoll_ctl_cmd *cmd = &kcmds[i];
+		struct epoll_event epds;
+		struct fd tf;
+
+		if (cmd->flags) {
+			cmd->result = -EINVAL;
+			continue;
+		}
+		tf = fdget(cmd->fd);
+		if (!tf.file) {
+			cmd->result = -EBADF;
+			continue;
+		}
+		epds.events = cmd->events;
+		epds.data = cmd->data;
+
+		if (ep_ctl_needs_full_check(f.file, tf.file, cmd->op)) {
+			/* epmutex nests outside of ep->mtx */
+			mutex_unlock(&ep->mtx);
+			cmd->result = ep_ctl(f.file, tf.file, cmd->fd,
+					     cmd->op, &epds);
+			mutex_lock_nested(&ep->mtx, 0);
+		} else {
+			cmd->result = ep_ctl_check(f.file, tf.file, cmd->op,
+						   &epds);
+			if (!cmd->result)
+				cmd->result = ep_ctl_locked(ep, cmd->op,
+							    tf.file, cmd->fd,
+							    &epds, 0);
+		}
+		fdput(tf);
+	}
+	mutex_unlock(&ep->mtx);
+
+	error = ncmds;
+	if (copy_to_user(cmds, kcmds, size))
+		error = -EFAULT;
+
+error_fput:
+	fdput(f);
+error_free:
+	kfree(kcmds);
+
+	return error;
+}
+
 /*
  * Implement the event wait interface for the eventpoll file. It is the kernel
  * part of the user space epoll_wait(2).
@@ -134,6 +134,8 @@ int ext4_mpage_readpages(struct address_space *mapping,
 			 struct list_head *pages, struct page *page,
 			 unsigned nr_pages)
 {
+	struct page *batch[PAGEVEC_SIZE];
+	unsigned batch_idx = 0, batch_nr = 0;
 	struct bio *bio = NULL;
 	unsigned page_idx;
 	sector_t last_block_in_bio = 0;
@@ -163,11 +165,17 @@ int ext4_mpage_readpages(struct address_space *mapping,
 
 		prefetchw(&page->flags);
 		if (pages) {
-			page = list_entry(pages->prev, struct page, lru);
-			list_del(&page->lru);
-			if (add_to_page_cache_lru(page, mapping,
-						  page->index, GFP_KERNEL))
-				goto next_page;
+			if (batch_idx == batch_nr) {
+				batch_nr = add_to_page_cache_lru_list(pages,
+					batch, min_t(unsigned, nr_pages,
+						     PAGEVEC_SIZE),
+					mapping, GFP_KERNEL);
+				batch_idx = 0;
+			}
+			/* Released already if it could not be added */
+			page = batch[batch_idx++];
+			if (!page)
+				continue;
 		}
 
 		if (page_has_buffers(page))
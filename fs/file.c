@@ -56,9 +56,35 @@ static void free_fdtable_rcu(struct rcu_head *rcu)
 	__free_fdtable(container_of(rcu, struct fdtable, rcu));
 }
 
+#define BITBIT_NR(nr)	BITS_TO_LONGS(BITS_TO_LONGS(nr))
+#define BITBIT_SIZE(nr)	(BITBIT_NR(nr) * sizeof(long))
+
+/*
+ * Copy 'count' fd bits from the old table to the new table and clear the extra
+ * space if any.  This does not copy the file pointers.  Called with the files
+ * spinlock held for write.
+ */
+static void copy_fd_bitmaps(struct fdtable *nfdt, struct fdtable *ofdt,
+			    unsigned int count)
+{
+	unsigned int cpy, set;
+
+	cpy = count / BITS_PER_BYTE;
+	set = (nfdt->max_fds - count) / BITS_PER_BYTE;
+	memcpy(nfdt->open_fds, ofdt->open_fds, cpy);
+	memset((char *)nfdt->open_fds + cpy, 0, set);
+	memcpy(nfdt->close_on_exec, ofdt->close_on_exec, cpy);
+	memset((char *)nfdt->close_on_exec + cpy, 0, set);
+
+	cpy = BITBIT_SIZE(count);
+	set = BITBIT_SIZE(nfdt->max_fds) - cpy;
+	memcpy(nfdt->full_fds_bits, ofdt->full_fds_bits, cpy);
+	memset((char *)nfdt->full_fds_bits + cpy, 0, set);
+}
+
 /*
- * Expand the fdset in the files_struct.  Called with the files spinlock
- * held for write.
+ * Copy all file descriptors from the old table to the new, expanded table and
+ * clear the extra space.  Called with the files spinlock held for write.
  */
 static void copy_fdtable(struct fdtable *nfdt, struct fdtable *ofdt)
 {
@@ -69,14 +95,9 @@ static void copy_fdtable(struct fdtable *nfdt, struct fdtable *ofdt)
 	cpy = ofdt->max_fds * sizeof(struct file *);
 	set = (nfdt->max_fds - ofdt->max_fds) * sizeof(struct file *);
 	memcpy(nfdt->fd, ofdt->fd, cpy);
-	memset((char *)(nfdt->fd) + cpy, 0, set);
+	memset((char *)nfdt->fd + cpy, 0, set);
 
-	cpy = ofdt->max_fds / BITS_PER_BYTE;
-	set = (nfdt->max_fds - ofdt->max_fds) / BITS_PER_BYTE;
-	memcpy(nfdt->open_fds, ofdt->open_fds, cpy);
-	memset((char *)(nfdt->open_fds) + cpy, 0, set);
-	memcpy(nfdt->close_on_exec, ofdt->close_on_exec, cpy);
-	memset((char *)(nfdt->close_on_exec) + cpy, 0, set);
+	copy_fd_bitmaps(nfdt, ofdt, ofdt->max_fds);
 }
 
 static struct fdtable * alloc_fdtable(unsigned int nr)
@@ -115,12 +136,15 @@ static struct fdtable * alloc_fdtable(unsigned int nr)
 	fdt->fd = data;
 
 	data = alloc_fdmem(max_t(size_t,
-				 2 * nr / BITS_PER_BYTE, L1_CACHE_BYTES));
+				 2 * nr / BITS_PER_BYTE + BITBIT_SIZE(nr),
+				 L1_CACHE_BYTES));
 	if (!data)
 		goto out_arr;
 	fdt->open_fds = data;
 	data += nr / BITS_PER_BYTE;
 	fdt->close_on_exec = data;
+	data += nr / BITS_PER_BYTE;
+	fdt->full_fds_bits = data;
 
 	return fdt;
 
@@ -219,24 +243,58 @@ repeat:
 	return expanded;
 }
 
-static inline void __set_close_on_exec(int fd, struct fdtable *fdt)
+/*
+ * The bitmaps below are modified with atomic bitops: when the table is
+ * shared, __alloc_fd() claims descriptors without ->file_lock, so a word
+ * may be updated by a lockless allocator and a locked updater at once.
+ */
+static inline void __set_close_on_exec(unsigned int fd, struct fdtable *fdt)
+{
+	set_bit(fd, fdt->close_on_exec);
+}
+
+static inline void __clear_close_on_exec(unsigned int fd, struct fdtable *fdt)
 {
-	__set_bit(fd, fdt->close_on_exec);
+	clear_bit(fd, fdt->close_on_exec);
 }
 
-static inline void __clear_close_on_exec(int fd, struct fdtable *fdt)
+/*
+ * full_fds_bits has one bit per word of open_fds, set when every fd in
+ * that word is in use.  It lets find_next_fd() skip fully allocated
+ * words instead of scanning the whole open_fds bitmap.
+ *
+ * A stale clear bit only costs a longer scan, but a stale set bit would
+ * hide a free descriptor, so after setting it we recheck the word in case
+ * a __clear_open_fd() raced with us.
+ */
+static inline void __update_full_fds_bit(unsigned int fd, struct fdtable *fdt)
 {
-	__clear_bit(fd, fdt->close_on_exec);
+	fd /= BITS_PER_LONG;
+	if (!~READ_ONCE(fdt->open_fds[fd])) {
+		set_bit(fd, fdt->full_fds_bits);
+		smp_mb__after_atomic();
+		if (~READ_ONCE(fdt->open_fds[fd]))
+			clear_bit(fd, fdt->full_fds_bits);
+	}
 }
 
-static inline void __set_open_fd(int fd, struct fdtable *fdt)
+/*
+ * Claim @fd; returns true if somebody else got there first.
+ */
+static inline bool __test_and_set_open_fd(unsigned int fd, struct fdtable *fdt)
 {
-	__set_bit(fd, fdt->open_fds);
+	if (test_and_set_bit(fd, fdt->open_fds))
+		return true;
+	__update_full_fds_bit(fd, fdt);
+	return false;
 }
 
-static inline void __clear_open_fd(int fd, struct fdtable *fdt)
+static inline void __clear_open_fd(unsigned int fd, struct fdtable *fdt)
 {
-	__clear_bit(fd, fdt->open_fds);
+	clear_bit(fd, fdt->open_fds);
+	/* pairs with smp_mb__after_atomic() in __update_full_fds_bit() */
+	smp_mb__after_atomic();
+	clear_bit(fd / BITS_PER_LONG, fdt->full_fds_bits);
 }
 
 static int count_open_files(struct fdtable *fdt)
@@ -280,6 +338,7 @@ struct files_struct *dup_fd(struct files_struct *oldf, int *errorp)
 	new_fdt->max_fds = NR_OPEN_DEFAULT;
 	new_fdt->close_on_exec = newf->close_on_exec_init;
 	new_fdt->open_fds = newf->open_fds_init;
+	new_fdt->full_fds_bits = newf->full_fds_bits_init;
 	new_fdt->fd = &newf->fd_array[0];
 
 	spin_lock(&oldf->file_lock);
@@ -321,13 +380,27 @@ struct files_struct *dup_fd(struct files_struct *oldf, int *errorp)
 	old_fds = old_fdt->fd;
 	new_fds = new_fdt->fd;
 
-	memcpy(new_fdt->open_fds, old_fdt->open_fds, open_files / 8);
-	memcpy(new_fdt->close_on_exec, old_fdt->close_on_exec, open_files / 8);
+	copy_fd_bitmaps(new_fdt, old_fdt, open_files);
 
 	for (i = open_files; i != 0; i--) {
 		struct file *f = *old_fds++;
 		if (f) {
+			unsigned int fd = open_files - i;
+
 			get_file(f);
+			/*
+			 * A lockless __alloc_fd() in a sibling thread may
+			 * have claimed this fd and set its close-on-exec
+			 * flag after we copied the bitmaps.  The flag is
+			 * written before the file is installed, so once we
+			 * see the file we can pick up the final bits.
+			 */
+			smp_rmb();
+			__set_bit(fd, new_fdt->open_fds);
+			if (close_on_exec(fd, old_fdt))
+				__set_bit(fd, new_fdt->close_on_exec);
+			else
+				__clear_bit(fd, new_fdt->close_on_exec);
 		} else {
 			/*
 			 * The fd may be claimed in the fd bitmap but not yet
@@ -347,14 +420,6 @@ struct files_struct *dup_fd(struct files_struct *oldf, int *errorp)
 	/* This is long word aligned thus could use a optimized version */
 	memset(new_fds, 0, size);
 
-	if (new_fdt->max_fds > open_files) {
-		int left = (new_fdt->max_fds - open_files) / 8;
-		int start = open_files / BITS_PER_LONG;
-
-		memset(&new_fdt->open_fds[start], 0, left);
-		memset(&new_fdt->close_on_exec[start], 0, left);
-	}
-
 	rcu_assign_pointer(newf->fdt, new_fdt);
 
 	return newf;
@@ -454,10 +519,75 @@ struct files_struct init_files = {
 		.fd		= &init_files.fd_array[0],
 		.close_on_exec	= init_files.close_on_exec_init,
 		.open_fds	= init_files.open_fds_init,
+		.full_fds_bits	= init_files.full_fds_bits_init,
 	},
 	.file_lock	= __SPIN_LOCK_UNLOCKED(init_files.file_lock),
 };
 
+static unsigned long find_next_fd(struct fdtable *fdt, unsigned long start)
+{
+	unsigned long maxfd = fdt->max_fds;
+	unsigned long maxbit = maxfd / BITS_PER_LONG;
+	unsigned long bitbit = start / BITS_PER_LONG;
+
+	bitbit = find_next_zero_bit(fdt->full_fds_bits, maxbit, bitbit) * BITS_PER_LONG;
+	if (bitbit > maxfd)
+		return maxfd;
+	if (bitbit > start)
+		start = bitbit;
+	return find_next_zero_bit(fdt->open_fds, maxfd, start);
+}
+
+/*
+ * Lockless descriptor allocation for shared tables.  The lowest free bit
+ * is claimed with test_and_set_bit() under rcu_read_lock_sched(), which
+ * is the same protection __fd_install() relies on against a concurrent
+ * expand_fdtable().  Descriptors are only ever released under ->file_lock,
+ * so ->next_fd stays a valid lower bound for the search; we never raise
+ * it here, as that would race with the locked updaters lowering it.
+ *
+ * Returns -EAGAIN when the table has to grow or is being resized, in
+ * which case the caller falls back to the locked path.
+ */
+static int __alloc_fd_lockless(struct files_struct *files,
+			       unsigned start, unsigned end, unsigned flags)
+{
+	struct fdtable *fdt;
+	unsigned int fd;
+	int error = -EAGAIN;
+
+	rcu_read_lock_sched();
+	if (unlikely(files->resize_in_progress))
+		goto out;
+	/* coupled with smp_wmb() in expand_fdtable() */
+	smp_rmb();
+	fdt = rcu_dereference_sched(files->fdt);
+
+	fd = max_t(unsigned int, start, READ_ONCE(files->next_fd));
+	for (;;) {
+		if (fd >= fdt->max_fds)
+			goto out;
+		fd = find_next_fd(fdt, fd);
+		if (fd >= fdt->max_fds)
+			goto out;
+		if (fd >= end) {
+			error = -EMFILE;
+			goto out;
+		}
+		if (!__test_and_set_open_fd(fd, fdt))
+			break;
+	}
+
+	if (flags & O_CLOEXEC)
+		__set_close_on_exec(fd, fdt);
+	else
+		__clear_close_on_exec(fd, fdt);
+	error = fd;
+out:
+	rcu_read_unlock_sched();
+	return error;
+}
+
 /*
  * allocate a file descriptor, mark it busy.
  */
@@ -468,6 +598,16 @@ int __alloc_fd(struct files_struct *files,
 	int error;
 	struct fdtable *fdt;
 
+	/*
+	 * A private table has nobody to contend with; keep the locked path
+	 * there since it also maintains ->next_fd.
+	 */
+	if (atomic_read(&files->count) > 1) {
+		error = __alloc_fd_lockless(files, start, end, flags);
+		if (error != -EAGAIN)
+			return error;
+	}
+
 	spin_lock(&files->file_lock);
 repeat:
 	fdt = files_fdtable(files);
@@ -476,7 +616,7 @@ repeat:
 		fd = files->next_fd;
 
 	if (fd < fdt->max_fds)
-		fd = find_next_zero_bit(fdt->open_fds, fdt->max_fds, fd);
+		fd = find_next_fd(fdt, fd);
 
 	/*
 	 * N.B. For clone tasks sharing a files structure, this test
@@ -497,10 +637,13 @@ repeat:
 	if (error)
 		goto repeat;
 
+	/* lost a race with a lockless allocator */
+	if (__test_and_set_open_fd(fd, fdt))
+		goto repeat;
+
 	if (start <= files->next_fd)
 		files->next_fd = fd + 1;
 
-	__set_open_fd(fd, fdt);
 	if (flags & O_CLOEXEC)
 		__set_close_on_exec(fd, fdt);
 	else
@@ -635,10 +778,14 @@ void do_close_on_exec(struct files_struct *files)
 		fdt = files_fdtable(files);
 		if (fd >= fdt->max_fds)
 			break;
-		set = fdt->close_on_exec[i];
-		if (!set)
+		if (!fdt->close_on_exec[i])
 			continue;
-		fdt->close_on_exec[i] = 0;
+		/*
+		 * A lockless __alloc_fd() on a shared table may set a bit
+		 * of this word under us; take the word atomically so that
+		 * the bit is either closed here or kept.
+		 */
+		set = xchg(&fdt->close_on_exec[i], 0);
 		for ( ; set ; fd++, set >>= 1) {
 			struct file *file;
 			if (!(set & 1))
@@ -805,11 +952,10 @@ __releases(&files->file_lock)
 	 */
 	fdt = files_fdtable(files);
 	tofree = fdt->fd[fd];
-	if (!tofree && fd_is_open(fd, fdt))
+	if (!tofree && __test_and_set_open_fd(fd, fdt))
 		goto Ebusy;
 	get_file(file);
 	rcu_assign_pointer(fdt->fd[fd], file);
-	__set_open_fd(fd, fdt);
 	if (flags & O_CLOEXEC)
 		__set_close_on_exec(fd, fdt);
 	else
@@ -48,6 +48,7 @@ extern void __init chrdev_init(void);
 /*
  * namei.c
  */
+extern void __init lookup_locks_init(void);
 extern int user_path_mountpoint_at(int, const char __user *, unsigned int, struct path *);
 extern int vfs_path_lookup(struct dentry *, struct vfsmount *,
 			   const char *, unsigned int, struct path *);
@@ -20,6 +20,7 @@
 
 DEFINE_MUTEX(kernfs_mutex);
 static DEFINE_SPINLOCK(kernfs_rename_lock);	/* kn->parent and ->name */
+static unsigned long kernfs_rename_gen;		/* bumped by every rename */
 static char kernfs_pr_cont_buf[PATH_MAX];	/* protected by rename_lock */
 
 #define rb_to_kn(X) rb_entry((X), struct kernfs_node, rb)
@@ -436,12 +437,33 @@ void kernfs_put(struct kernfs_node *kn)
 }
 EXPORT_SYMBOL_GPL(kernfs_put);
 
+/*
+ * In RCU-walk mode a dentry is good if its node is still active and
+ * nothing was renamed since the dentry was last checked with kernfs_mutex
+ * held, which is recorded in ->d_time.  Anything else is left to ref-walk.
+ * kernfs_node_cache is SLAB_DESTROY_BY_RCU, so looking at a node which is
+ * being released is harmless; the caller rechecks the dentry afterwards.
+ */
+static int kernfs_dop_revalidate_rcu(struct dentry *dentry)
+{
+	struct kernfs_node *kn = ACCESS_ONCE(dentry->d_fsdata);
+
+	if (d_really_is_negative(dentry) || !kn)
+		return -ECHILD;
+	if (atomic_read(&kn->active) < 0)
+		return -ECHILD;
+	smp_rmb();	/* pairs with smp_wmb() in kernfs_rename_ns() */
+	if (dentry->d_time != ACCESS_ONCE(kernfs_rename_gen))
+		return -ECHILD;
+	return 1;
+}
+
 static int kernfs_dop_revalidate(struct dentry *dentry, unsigned int flags)
 {
 	struct kernfs_node *kn;
 
 	if (flags & LOOKUP_RCU)
-		return -ECHILD;
+		return kernfs_dop_revalidate_rcu(dentry);
 
 	/* Always perform fresh lookup for negatives */
 	if (d_really_is_negative(dentry))
@@ -467,6 +489,7 @@ static int kernfs_dop_revalidate(struct dentry *dentry, unsigned int flags)
 	    kernfs_info(dentry->d_sb)->ns != kn->ns)
 		goto out_bad;
 
+	dentry->d_time = kernfs_rename_gen;
 	mutex_unlock(&kernfs_mutex);
 	return 1;
 out_bad:
@@ -842,6 +865,7 @@ static struct dentry *kernfs_iop_lookup(struct inode *dir,
 	}
 	kernfs_get(kn);
 	dentry->d_fsdata = kn;
+	dentry->d_time = kernfs_rename_gen;
 
 	/* attach dentry and inode */
 	inode = kernfs_get_inode(dir->i_sb, kn);
@@ -1321,6 +1345,10 @@ int kernfs_rename_ns(struct kernfs_node *kn, struct kernfs_node *new_parent,
 	/* rename_lock protects ->parent and ->name accessors */
 	spin_lock_irq(&kernfs_rename_lock);
 
+	/* invalidate RCU-walk revalidation, see kernfs_dop_revalidate_rcu() */
+	kernfs_rename_gen++;
+	smp_wmb();
+
 	old_parent = kn->parent;
 	kn->parent = new_parent;
 
@@ -357,12 +357,18 @@ void kernfs_evict_inode(struct inode *inode)
 
 int kernfs_iop_permission(struct inode *inode, int mask)
 {
-	struct kernfs_node *kn;
-
-	if (mask & MAY_NOT_BLOCK)
-		return -ECHILD;
+	struct kernfs_node *kn = inode->i_private;
 
-	kn = inode->i_private;
+	/*
+	 * The inode only needs refreshing if the attributes were ever set
+	 * through kernfs_setattr(), otherwise it is as kernfs_init_inode()
+	 * left it and can be checked without kernfs_mutex.
+	 */
+	if (mask & MAY_NOT_BLOCK) {
+		if (ACCESS_ONCE(kn->iattr))
+			return -ECHILD;
+		return generic_permission(inode, mask);
+	}
 
 	mutex_lock(&kernfs_mutex);
 	kernfs_refresh_inode(kn, inode);
@@ -127,6 +127,7 @@
 #include <linux/rcupdate.h>
 #include <linux/pid_namespace.h>
 #include <linux/hashtable.h>
+#include <linux/interval_tree_generic.h>
 #include <linux/percpu.h>
 #include <linux/lglock.h>
 
@@ -217,6 +218,7 @@ locks_get_lock_context(struct inode *inode, int type)
 	spin_lock_init(&new->flc_lock);
 	INIT_LIST_HEAD(&new->flc_flock);
 	INIT_LIST_HEAD(&new->flc_posix);
+	new->flc_posix_tree = RB_ROOT;
 	INIT_LIST_HEAD(&new->flc_lease);
 
 	/*
@@ -235,6 +237,7 @@ locks_free_lock_context(struct file_lock_context *ctx)
 	if (ctx) {
 		WARN_ON_ONCE(!list_empty(&ctx->flc_flock));
 		WARN_ON_ONCE(!list_empty(&ctx->flc_posix));
+		WARN_ON_ONCE(!RB_EMPTY_ROOT(&ctx->flc_posix_tree));
 		WARN_ON_ONCE(!list_empty(&ctx->flc_lease));
 		kmem_cache_free(flctx_cache, ctx);
 	}
@@ -709,6 +712,51 @@ locks_delete_lock_ctx(struct file_lock *fl, struct list_head *dispose)
 		locks_free_lock(fl);
 }
 
+/*
+ * Besides the flc_posix list, POSIX locks are kept in an interval tree
+ * keyed by their range, so that finding the locks which overlap a range
+ * doesn't mean walking every lock on the inode. Both are protected by the
+ * flc_lock.
+ */
+static inline loff_t posix_lock_start(struct file_lock *fl)
+{
+	return fl->fl_start;
+}
+
+static inline loff_t posix_lock_last(struct file_lock *fl)
+{
+	return fl->fl_end;
+}
+
+INTERVAL_TREE_DEFINE(struct file_lock, fl_rb, loff_t, fl_rb_subtree_last,
+		     posix_lock_start, posix_lock_last, static, posix_lock_tree)
+
+static void
+posix_insert_lock(struct file_lock_context *ctx, struct file_lock *fl)
+{
+	locks_insert_lock_ctx(fl, &ctx->flc_posix);
+	posix_lock_tree_insert(fl, &ctx->flc_posix_tree);
+}
+
+static void
+posix_delete_lock(struct file_lock_context *ctx, struct file_lock *fl,
+		  struct list_head *dispose)
+{
+	posix_lock_tree_remove(fl, &ctx->flc_posix_tree);
+	locks_delete_lock_ctx(fl, dispose);
+}
+
+/* Change the range of a POSIX lock that is in the tree. */
+static void
+posix_set_range(struct file_lock_context *ctx, struct file_lock *fl,
+		loff_t start, loff_t end)
+{
+	posix_lock_tree_remove(fl, &ctx->flc_posix_tree);
+	fl->fl_start = start;
+	fl->fl_end = end;
+	posix_lock_tree_insert(fl, &ctx->flc_posix_tree);
+}
+
 /* Determine if lock sys_fl blocks lock caller_fl. Common functionality
  * checks for shared/exclusive status of overlapping locks.
  */
@@ -769,7 +817,10 @@ posix_test_lock(struct file *filp, struct file_lock *fl)
 	}
 
 	spin_lock(&ctx->flc_lock);
-	list_for_each_entry(cfl, &ctx->flc_posix, fl_list) {
+	cfl = posix_lock_tree_iter_first(&ctx->flc_posix_tree, fl->fl_start,
+					 fl->fl_end);
+	for (; cfl; cfl = posix_lock_tree_iter_next(cfl, fl->fl_start,
+						    fl->fl_end)) {
 		if (posix_locks_conflict(fl, cfl)) {
 			locks_copy_conflock(fl, cfl);
 			if (cfl->fl_nspid)
@@ -937,7 +988,9 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 	struct file_lock *new_fl2 = NULL;
 	struct file_lock *left = NULL;
 	struct file_lock *right = NULL;
+	struct file_lock *detached = NULL;
 	struct file_lock_context *ctx;
+	loff_t lo, hi;
 	int error;
 	bool added = false;
 	LIST_HEAD(dispose);
@@ -961,12 +1014,17 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 
 	spin_lock(&ctx->flc_lock);
 	/*
-	 * New lock request. Walk all POSIX locks and look for conflicts. If
-	 * there are any, either return error or put the request on the
-	 * blocker's list of waiters and the global blocked_hash.
+	 * New lock request. Look for conflicts among the POSIX locks that
+	 * overlap it. If there are any, either return error or put the
+	 * request on the blocker's list of waiters and the global
+	 * blocked_hash.
 	 */
 	if (request->fl_type != F_UNLCK) {
-		list_for_each_entry(fl, &ctx->flc_posix, fl_list) {
+		fl = posix_lock_tree_iter_first(&ctx->flc_posix_tree,
+						request->fl_start,
+						request->fl_end);
+		for (; fl; fl = posix_lock_tree_iter_next(fl, request->fl_start,
+							  request->fl_end)) {
 			if (!posix_locks_conflict(request, fl))
 				continue;
 			if (conflock)
@@ -994,27 +1052,30 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 	if (request->fl_flags & FL_ACCESS)
 		goto out;
 
-	/* Find the first old lock with the same owner as the new lock */
-	list_for_each_entry(fl, &ctx->flc_posix, fl_list) {
-		if (posix_same_owner(request, fl))
-			break;
-	}
-
-	/* Process locks with this owner. */
-	list_for_each_entry_safe_from(fl, tmp, &ctx->flc_posix, fl_list) {
+	/*
+	 * Process the locks with this owner that overlap or are adjacent to
+	 * the new one, in order of their start. A lock whose range is going
+	 * to change is taken out of the tree (it stays on the list) and put
+	 * back once we are done; the only one that can be left out like
+	 * that is the lock the new one is merged into or replaces.
+	 *
+	 * In all comparisons of start vs end, use "start - 1" rather than
+	 * "end + 1". If end is OFFSET_MAX, end + 1 will become negative.
+	 */
+	lo = request->fl_start ? request->fl_start - 1 : 0;
+	hi = request->fl_end == OFFSET_MAX ? OFFSET_MAX : request->fl_end + 1;
+	fl = posix_lock_tree_iter_first(&ctx->flc_posix_tree, lo, hi);
+	for (; fl; fl = tmp) {
+		tmp = posix_lock_tree_iter_next(fl, lo, hi);
 		if (!posix_same_owner(request, fl))
-			break;
+			continue;
 
 		/* Detect adjacent or overlapping regions (if same lock type) */
 		if (request->fl_type == fl->fl_type) {
-			/* In all comparisons of start vs end, use
-			 * "start - 1" rather than "end + 1". If end
-			 * is OFFSET_MAX, end + 1 will become negative.
-			 */
 			if (fl->fl_end < request->fl_start - 1)
 				continue;
-			/* If the next lock in the list has entirely bigger
-			 * addresses than the new one, insert the lock here.
+			/* If the next lock has entirely bigger addresses
+			 * than the new one, we're done.
 			 */
 			if (fl->fl_start - 1 > request->fl_end)
 				break;
@@ -1024,6 +1085,15 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			 * lock yielding from the lower start address of both
 			 * locks to the higher end address.
 			 */
+			if (added) {
+				if (fl->fl_start < request->fl_start)
+					request->fl_start = fl->fl_start;
+				if (fl->fl_end > request->fl_end)
+					request->fl_end = fl->fl_end;
+				posix_delete_lock(ctx, fl, &dispose);
+				continue;
+			}
+			posix_lock_tree_remove(fl, &ctx->flc_posix_tree);
 			if (fl->fl_start > request->fl_start)
 				fl->fl_start = request->fl_start;
 			else
@@ -1032,11 +1102,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				fl->fl_end = request->fl_end;
 			else
 				request->fl_end = fl->fl_end;
-			if (added) {
-				locks_delete_lock_ctx(fl, &dispose);
-				continue;
-			}
-			request = fl;
+			request = detached = fl;
 			added = true;
 		} else {
 			/* Processing for different lock types is a bit
@@ -1050,8 +1116,8 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				added = true;
 			if (fl->fl_start < request->fl_start)
 				left = fl;
-			/* If the next lock in the list has a higher end
-			 * address than the new one, insert the new one here.
+			/* If the next lock has a higher end address than
+			 * the new one, we're done.
 			 */
 			if (fl->fl_end > request->fl_end) {
 				right = fl;
@@ -1062,7 +1128,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				 * one (This may happen several times).
 				 */
 				if (added) {
-					locks_delete_lock_ctx(fl, &dispose);
+					posix_delete_lock(ctx, fl, &dispose);
 					continue;
 				}
 				/*
@@ -1076,10 +1142,10 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				if (!new_fl)
 					goto out;
 				locks_copy_lock(new_fl, request);
-				request = new_fl;
+				request = detached = new_fl;
 				new_fl = NULL;
-				locks_insert_lock_ctx(request, &fl->fl_list);
-				locks_delete_lock_ctx(fl, &dispose);
+				locks_insert_lock_ctx(request, &ctx->flc_posix);
+				posix_delete_lock(ctx, fl, &dispose);
 				added = true;
 			}
 		}
@@ -1092,7 +1158,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 	 */
 	error = -ENOLCK; /* "no luck" */
 	if (right && left == right && !new_fl2)
-		goto out;
+		goto out_reinsert;
 
 	error = 0;
 	if (!added) {
@@ -1107,8 +1173,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			goto out;
 		}
 		locks_copy_lock(new_fl, request);
-		locks_insert_lock_ctx(new_fl, &fl->fl_list);
-		fl = new_fl;
+		posix_insert_lock(ctx, new_fl);
 		new_fl = NULL;
 	}
 	if (right) {
@@ -1119,15 +1184,18 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			left = new_fl2;
 			new_fl2 = NULL;
 			locks_copy_lock(left, right);
-			locks_insert_lock_ctx(left, &fl->fl_list);
+			posix_insert_lock(ctx, left);
 		}
-		right->fl_start = request->fl_end + 1;
+		posix_set_range(ctx, right, request->fl_end + 1, right->fl_end);
 		locks_wake_up_blocks(right);
 	}
 	if (left) {
-		left->fl_end = request->fl_start - 1;
+		posix_set_range(ctx, left, left->fl_start, request->fl_start - 1);
 		locks_wake_up_blocks(left);
 	}
+ out_reinsert:
+	if (detached)
+		posix_lock_tree_insert(detached, &ctx->flc_posix_tree);
  out:
 	spin_unlock(&ctx->flc_lock);
 	/*
@@ -1149,7 +1217,8 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
  *
  * Add a POSIX style lock to a file.
  * We merge adjacent & overlapping locks whenever possible.
- * POSIX locks are sorted by owner task, then by starting address
+ * POSIX locks are looked up by range in the inode's interval tree; the
+ * flc_posix list is in no particular order.
  *
  * Note that if called with an FL_EXISTS argument, the caller may determine
  * whether or not a lock was successfully freed by testing the return
@@ -1441,12 +1441,139 @@ static int follow_dotdot(struct nameidata *nd)
 	return 0;
 }
 
+/*
+ * Parallel lookups.
+ *
+ * File systems with FS_PARALLEL_LOOKUP look up names which miss the dcache
+ * without the directory's i_mutex, so lookups of different names in one
+ * directory run at the same time.  Their ->lookup() has to cope with other
+ * lookups in the same directory, but not with changes to it, nor with
+ * lookups done under i_mutex, which could add a second dentry for a name.
+ * Those take the directory's lookup lock exclusive, on top of i_mutex,
+ * while lockless lookups take it shared.  Lockless lookups of the same
+ * name are serialized by a name lock, so that the second one finds the
+ * dentry added by the first.
+ *
+ * Removing a directory also takes its own lookup lock, so that a lockless
+ * lookup in it sees S_DEAD once the directory is gone.
+ *
+ * Both kinds of lock are hashed rather than kept in every inode.  Nothing
+ * is taken under either, except the other directory lookup locks of a
+ * rename or rmdir, in address order.
+ */
+#define DIR_LOOKUP_LOCK_BITS	8
+#define NAME_LOOKUP_LOCK_BITS	10
+
+static struct rw_semaphore dir_lookup_locks[1 << DIR_LOOKUP_LOCK_BITS];
+static struct mutex name_lookup_locks[1 << NAME_LOOKUP_LOCK_BITS];
+
+void __init lookup_locks_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dir_lookup_locks); i++)
+		init_rwsem(&dir_lookup_locks[i]);
+	for (i = 0; i < ARRAY_SIZE(name_lookup_locks); i++)
+		mutex_init(&name_lookup_locks[i]);
+}
+
+static inline bool parallel_lookup(struct inode *dir)
+{
+	return dir->i_sb->s_type->fs_flags & FS_PARALLEL_LOOKUP;
+}
+
+static inline struct rw_semaphore *dir_lookup_lock(struct inode *dir)
+{
+	return &dir_lookup_locks[hash_ptr(dir, DIR_LOOKUP_LOCK_BITS)];
+}
+
+static inline struct mutex *name_lookup_lock(struct dentry *dir,
+					     struct qstr *name)
+{
+	unsigned long hash = (unsigned long)dir + name->hash;
+
+	return &name_lookup_locks[hash_long(hash, NAME_LOOKUP_LOCK_BITS)];
+}
+
+/* Keep lockless lookups out of @dir; i_mutex must be held */
+static inline void lock_dir_lookups(struct inode *dir)
+{
+	if (parallel_lookup(dir))
+		down_write(dir_lookup_lock(dir));
+}
+
+static inline void unlock_dir_lookups(struct inode *dir)
+{
+	if (parallel_lookup(dir))
+		up_write(dir_lookup_lock(dir));
+}
+
+/*
+ * Collect the distinct lookup locks of @dirs (NULL entries are skipped) in
+ * address order, which is the order they are taken in.
+ */
+static int dir_lookup_locks_sorted(struct inode **dirs, int nr,
+				   struct rw_semaphore **locks)
+{
+	int i, j, n = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct rw_semaphore *lock;
+
+		if (!dirs[i])
+			continue;
+		lock = dir_lookup_lock(dirs[i]);
+		for (j = 0; j < n && locks[j] < lock; j++)
+			;
+		if (j < n && locks[j] == lock)
+			continue;
+		memmove(&locks[j + 1], &locks[j], (n - j) * sizeof(*locks));
+		locks[j] = lock;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * The same for the directories of a rename or rmdir: the parents, and the
+ * directory being removed (if any, else NULL), which gets marked S_DEAD
+ * under its lock.  They are on the same super block and may share locks.
+ */
+static void lock_dirs_lookups(struct inode *dir1, struct inode *dir2,
+			      struct inode *victim)
+{
+	struct inode *dirs[] = { dir1, dir2, victim };
+	struct rw_semaphore *locks[ARRAY_SIZE(dirs)];
+	int i, n;
+
+	if (!parallel_lookup(dir1))
+		return;
+	n = dir_lookup_locks_sorted(dirs, ARRAY_SIZE(dirs), locks);
+	for (i = 0; i < n; i++)
+		down_write_nested(locks[i], i);
+}
+
+static void unlock_dirs_lookups(struct inode *dir1, struct inode *dir2,
+				struct inode *victim)
+{
+	struct inode *dirs[] = { dir1, dir2, victim };
+	struct rw_semaphore *locks[ARRAY_SIZE(dirs)];
+	int n;
+
+	if (!parallel_lookup(dir1))
+		return;
+	n = dir_lookup_locks_sorted(dirs, ARRAY_SIZE(dirs), locks);
+	while (n--)
+		up_write(locks[n]);
+}
+
 /*
  * This looks up the name in dcache, possibly revalidates the old dentry and
  * allocates a new one if not found or not valid.  In the need_lookup argument
  * returns whether i_op->lookup is necessary.
  *
- * dir->d_inode->i_mutex must be held
+ * dir->d_inode->i_mutex must be held, or for parallel lookups the
+ * directory's lookup lock (shared) and the name lock.
  */
 static struct dentry *lookup_dcache(struct qstr *name, struct dentry *dir,
 				    unsigned int flags, bool *need_lookup)
@@ -1486,7 +1613,7 @@ static struct dentry *lookup_dcache(struct qstr *name, struct dentry *dir,
  * Call i_op->lookup on the dentry.  The dentry must be negative and
  * unhashed.
  *
- * dir->d_inode->i_mutex must be held
+ * Locking as for lookup_dcache().
  */
 static struct dentry *lookup_real(struct inode *dir, struct dentry *dentry,
 				  unsigned int flags)
@@ -1507,17 +1634,46 @@ static struct dentry *lookup_real(struct inode *dir, struct dentry *dentry,
 	return dentry;
 }
 
+/* base->d_inode->i_mutex must be held */
 static struct dentry *__lookup_hash(struct qstr *name,
 		struct dentry *base, unsigned int flags)
 {
+	struct inode *dir = base->d_inode;
 	bool need_lookup;
 	struct dentry *dentry;
 
+	lock_dir_lookups(dir);
 	dentry = lookup_dcache(name, base, flags, &need_lookup);
-	if (!need_lookup)
-		return dentry;
+	if (need_lookup)
+		dentry = lookup_real(dir, dentry, flags);
+	unlock_dir_lookups(dir);
+	return dentry;
+}
+
+/* Look a name up without i_mutex, see "Parallel lookups" above */
+static struct dentry *lookup_parallel(struct qstr *name,
+		struct dentry *base, unsigned int flags)
+{
+	struct inode *dir = base->d_inode;
+	struct mutex *name_lock = name_lookup_lock(base, name);
+	bool need_lookup;
+	struct dentry *dentry;
 
-	return lookup_real(base->d_inode, dentry, flags);
+	down_read(dir_lookup_lock(dir));
+	mutex_lock(name_lock);
+	dentry = lookup_dcache(name, base, flags, &need_lookup);
+	if (need_lookup) {
+		/* Nothing keeps the directory from being removed meanwhile */
+		if (unlikely(IS_DEADDIR(dir))) {
+			dput(dentry);
+			dentry = ERR_PTR(-ENOENT);
+		} else {
+			dentry = lookup_real(dir, dentry, flags);
+		}
+	}
+	mutex_unlock(name_lock);
+	up_read(dir_lookup_lock(dir));
+	return dentry;
 }
 
 /*
@@ -1630,9 +1786,13 @@ static int lookup_slow(struct nameidata *nd, struct path *path)
 	parent = nd->path.dentry;
 	BUG_ON(nd->inode != parent->d_inode);
 
-	mutex_lock(&parent->d_inode->i_mutex);
-	dentry = __lookup_hash(&nd->last, parent, nd->flags);
-	mutex_unlock(&parent->d_inode->i_mutex);
+	if (parallel_lookup(parent->d_inode)) {
+		dentry = lookup_parallel(&nd->last, parent, nd->flags);
+	} else {
+		mutex_lock(&parent->d_inode->i_mutex);
+		dentry = __lookup_hash(&nd->last, parent, nd->flags);
+		mutex_unlock(&parent->d_inode->i_mutex);
+	}
 	if (IS_ERR(dentry))
 		return PTR_ERR(dentry);
 	path->mnt = nd->path.mnt;
@@ -2403,6 +2563,7 @@ mountpoint_last(struct nameidata *nd, struct path *path)
 	}
 
 	mutex_lock(&dir->d_inode->i_mutex);
+	lock_dir_lookups(dir->d_inode);
 	dentry = d_lookup(dir, &nd->last);
 	if (!dentry) {
 		/*
@@ -2411,17 +2572,15 @@ mountpoint_last(struct nameidata *nd, struct path *path)
 		 * path doesn't actually point to a mounted dentry.
 		 */
 		dentry = d_alloc(dir, &nd->last);
-		if (!dentry) {
-			mutex_unlock(&dir->d_inode->i_mutex);
-			return -ENOMEM;
-		}
-		dentry = lookup_real(dir->d_inode, dentry, nd->flags);
-		if (IS_ERR(dentry)) {
-			mutex_unlock(&dir->d_inode->i_mutex);
-			return PTR_ERR(dentry);
-		}
+		if (dentry)
+			dentry = lookup_real(dir->d_inode, dentry, nd->flags);
+		else
+			dentry = ERR_PTR(-ENOMEM);
 	}
+	unlock_dir_lookups(dir->d_inode);
 	mutex_unlock(&dir->d_inode->i_mutex);
+	if (IS_ERR(dentry))
+		return PTR_ERR(dentry);
 
 done:
 	if (d_is_negative(dentry)) {
@@ -2661,7 +2820,9 @@ int vfs_create(struct inode *dir, struct dentry *dentry, umode_t mode,
 	error = security_inode_create(dir, dentry, mode);
 	if (error)
 		return error;
+	lock_dir_lookups(dir);
 	error = dir->i_op->create(dir, dentry, mode, want_excl);
+	unlock_dir_lookups(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -2947,15 +3108,22 @@ static int lookup_open(struct nameidata *nd, struct path *path,
 	bool need_lookup;
 
 	*opened &= ~FILE_CREATED;
+	lock_dir_lookups(dir_inode);
 	dentry = lookup_dcache(&nd->last, dir, nd->flags, &need_lookup);
-	if (IS_ERR(dentry))
+	if (IS_ERR(dentry)) {
+		unlock_dir_lookups(dir_inode);
 		return PTR_ERR(dentry);
+	}
 
 	/* Cached positive dentry: will open in f_op->open */
-	if (!need_lookup && dentry->d_inode)
+	if (!need_lookup && dentry->d_inode) {
+		unlock_dir_lookups(dir_inode);
 		goto out_no_open;
+	}
 
+	/* FS_PARALLEL_LOOKUP file systems have no ->atomic_open() */
 	if ((nd->flags & LOOKUP_OPEN) && dir_inode->i_op->atomic_open) {
+		unlock_dir_lookups(dir_inode);
 		return atomic_open(nd, dentry, path, file, op, got_write,
 				   need_lookup, opened);
 	}
@@ -2964,9 +3132,10 @@ static int lookup_open(struct nameidata *nd, struct path *path,
 		BUG_ON(dentry->d_inode);
 
 		dentry = lookup_real(dir_inode, dentry, nd->flags);
-		if (IS_ERR(dentry))
-			return PTR_ERR(dentry);
 	}
+	unlock_dir_lookups(dir_inode);
+	if (IS_ERR(dentry))
+		return PTR_ERR(dentry);
 
 	/* Negative dentry, just create the file */
 	if (!dentry->d_inode && (op->open_flag & O_CREAT)) {
@@ -3505,7 +3674,9 @@ int vfs_mknod(struct inode *dir, struct dentry *dentry, umode_t mode, dev_t dev)
 	if (error)
 		return error;
 
+	lock_dir_lookups(dir);
 	error = dir->i_op->mknod(dir, dentry, mode, dev);
+	unlock_dir_lookups(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -3595,7 +3766,9 @@ int vfs_mkdir(struct inode *dir, struct dentry *dentry, umode_t mode)
 	if (max_links && dir->i_nlink >= max_links)
 		return -EMLINK;
 
+	lock_dir_lookups(dir);
 	error = dir->i_op->mkdir(dir, dentry, mode);
+	unlock_dir_lookups(dir);
 	if (!error)
 		fsnotify_mkdir(dir, dentry);
 	return error;
@@ -3679,11 +3852,15 @@ int vfs_rmdir(struct inode *dir, struct dentry *dentry)
 		goto out;
 
 	shrink_dcache_parent(dentry);
+	/* lookups in the victim check S_DEAD under its lock */
+	lock_dirs_lookups(dir, dir, dentry->d_inode);
 	error = dir->i_op->rmdir(dir, dentry);
+	if (!error)
+		dentry->d_inode->i_flags |= S_DEAD;
+	unlock_dirs_lookups(dir, dir, dentry->d_inode);
 	if (error)
 		goto out;
 
-	dentry->d_inode->i_flags |= S_DEAD;
 	dont_mount(dentry);
 	detach_mounts(dentry);
 
@@ -3798,7 +3975,9 @@ int vfs_unlink(struct inode *dir, struct dentry *dentry, struct inode **delegate
 			error = try_break_deleg(target, delegated_inode);
 			if (error)
 				goto out;
+			lock_dir_lookups(dir);
 			error = dir->i_op->unlink(dir, dentry);
+			unlock_dir_lookups(dir);
 			if (!error) {
 				dont_mount(dentry);
 				detach_mounts(dentry);
@@ -3927,7 +4106,9 @@ int vfs_symlink(struct inode *dir, struct dentry *dentry, const char *oldname)
 	if (error)
 		return error;
 
+	lock_dir_lookups(dir);
 	error = dir->i_op->symlink(dir, dentry, oldname);
+	unlock_dir_lookups(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -4027,8 +4208,11 @@ int vfs_link(struct dentry *old_dentry, struct inode *dir, struct dentry *new_de
 		error = -EMLINK;
 	else {
 		error = try_break_deleg(inode, delegated_inode);
-		if (!error)
+		if (!error) {
+			lock_dir_lookups(dir);
 			error = dir->i_op->link(old_dentry, dir, new_dentry);
+			unlock_dir_lookups(dir);
+		}
 	}
 
 	if (!error && (inode->i_state & I_LINKABLE)) {
@@ -4180,6 +4364,8 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	const unsigned char *old_name;
 	struct inode *source = old_dentry->d_inode;
 	struct inode *target = new_dentry->d_inode;
+	/* a directory replaced by the rename */
+	struct inode *victim = NULL;
 	bool new_is_dir = false;
 	unsigned max_links = new_dir->i_sb->s_max_links;
 
@@ -4254,8 +4440,10 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		    old_dir->i_nlink >= max_links)
 			goto out;
 	}
-	if (is_dir && !(flags & RENAME_EXCHANGE) && target)
+	if (is_dir && !(flags & RENAME_EXCHANGE) && target) {
 		shrink_dcache_parent(new_dentry);
+		victim = target;
+	}
 	if (!is_dir) {
 		error = try_break_deleg(source, delegated_inode);
 		if (error)
@@ -4266,6 +4454,7 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		if (error)
 			goto out;
 	}
+	lock_dirs_lookups(old_dir, new_dir, victim);
 	if (!old_dir->i_op->rename2) {
 		error = old_dir->i_op->rename(old_dir, old_dentry,
 					      new_dir, new_dentry);
@@ -4274,12 +4463,13 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		error = old_dir->i_op->rename2(old_dir, old_dentry,
 					       new_dir, new_dentry, flags);
 	}
+	if (!error && victim)
+		victim->i_flags |= S_DEAD;
+	unlock_dirs_lookups(old_dir, new_dir, victim);
 	if (error)
 		goto out;
 
 	if (!(flags & RENAME_EXCHANGE) && target) {
-		if (is_dir)
-			target->i_flags |= S_DEAD;
 		dont_mount(new_dentry);
 		detach_mounts(new_dentry);
 	}
@@ -4472,8 +4662,11 @@ int vfs_whiteout(struct inode *dir, struct dentry *dentry)
 	if (!dir->i_op->mknod)
 		return -EPERM;
 
-	return dir->i_op->mknod(dir, dentry,
-				S_IFCHR | WHITEOUT_MODE, WHITEOUT_DEV);
+	lock_dir_lookups(dir);
+	error = dir->i_op->mknod(dir, dentry,
+				 S_IFCHR | WHITEOUT_MODE, WHITEOUT_DEV);
+	unlock_dir_lookups(dir);
+	return error;
 }
 EXPORT_SYMBOL(vfs_whiteout);
 
@@ -15,12 +15,14 @@
 #include <linux/mount.h>
 #include <linux/magic.h>
 #include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 #include <linux/uio.h>
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
 #include <linux/audit.h>
 #include <linux/syscalls.h>
 #include <linux/fcntl.h>
+#include <linux/vmstat.h>
 
 #include <asm/uaccess.h>
 #include <asm/ioctls.h>
@@ -121,18 +123,115 @@ void pipe_wait(struct pipe_inode_info *pipe)
 	pipe_lock(pipe);
 }
 
+/*
+ * Released anonymous pages are kept in a small per-pipe pool, so that a
+ * pipe with a steady stream of data going through it does not hit the
+ * page allocator for every buffer.  The pool never holds more pages than
+ * the ring has slots, which bounds it by what the pipe could pin anyway.
+ * Pipes with pooled pages are kept on pipe_pools, so that the pools of
+ * idle pipes can be given back under memory pressure, see
+ * pipe_pool_scan().
+ */
+static LIST_HEAD(pipe_pools);
+static DEFINE_SPINLOCK(pipe_pools_lock);
+static atomic_long_t pipe_pool_pages;
+
+static inline unsigned int pipe_pool_size(struct pipe_inode_info *pipe)
+{
+	return min_t(unsigned int, pipe->buffers, ARRAY_SIZE(pipe->tmp_pages));
+}
+
+static struct page *pipe_get_page(struct pipe_inode_info *pipe)
+{
+	struct page *page;
+
+	if (pipe->nr_tmp_pages) {
+		count_vm_event(PIPE_PAGE_RECYCLE);
+		atomic_long_dec(&pipe_pool_pages);
+		return pipe->tmp_pages[--pipe->nr_tmp_pages];
+	}
+
+	page = alloc_page(GFP_HIGHUSER);
+	if (page)
+		count_vm_event(PIPE_PAGE_ALLOC);
+	return page;
+}
+
+static void pipe_put_page(struct pipe_inode_info *pipe, struct page *page)
+{
+	if (pipe->nr_tmp_pages >= pipe_pool_size(pipe)) {
+		__free_page(page);
+		return;
+	}
+
+	/* Only changed with pipe->mutex held, see pipe_pool_scan() */
+	if (list_empty(&pipe->pool_list)) {
+		spin_lock(&pipe_pools_lock);
+		list_add_tail(&pipe->pool_list, &pipe_pools);
+		spin_unlock(&pipe_pools_lock);
+	}
+	pipe->tmp_pages[pipe->nr_tmp_pages++] = page;
+	atomic_long_inc(&pipe_pool_pages);
+}
+
+/* Trim the pool down to @nr pages */
+static void pipe_drain_pages(struct pipe_inode_info *pipe, unsigned int nr)
+{
+	while (pipe->nr_tmp_pages > nr) {
+		__free_page(pipe->tmp_pages[--pipe->nr_tmp_pages]);
+		atomic_long_dec(&pipe_pool_pages);
+	}
+}
+
+static unsigned long pipe_pool_count(struct shrinker *shrink,
+				     struct shrink_control *sc)
+{
+	return atomic_long_read(&pipe_pool_pages);
+}
+
+/*
+ * Empty the pools of the pipes nobody is using right now.  Pipes which are
+ * busy are skipped, their pools are being recycled anyway.
+ */
+static unsigned long pipe_pool_scan(struct shrinker *shrink,
+				    struct shrink_control *sc)
+{
+	struct pipe_inode_info *pipe, *next;
+	unsigned long freed = 0;
+
+	spin_lock(&pipe_pools_lock);
+	list_for_each_entry_safe(pipe, next, &pipe_pools, pool_list) {
+		if (freed >= sc->nr_to_scan)
+			break;
+		if (!mutex_trylock(&pipe->mutex))
+			continue;
+		freed += pipe->nr_tmp_pages;
+		pipe_drain_pages(pipe, 0);
+		list_del_init(&pipe->pool_list);
+		mutex_unlock(&pipe->mutex);
+	}
+	spin_unlock(&pipe_pools_lock);
+
+	return freed;
+}
+
+static struct shrinker pipe_pool_shrinker = {
+	.count_objects	= pipe_pool_count,
+	.scan_objects	= pipe_pool_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
 static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
 	struct page *page = buf->page;
 
 	/*
-	 * If nobody else uses this page, and we don't already have a
-	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
+	 * If nobody else uses this page, keep it around for the next
+	 * write. (Otherwise just release our reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
+	if (page_count(page) == 1)
+		pipe_put_page(pipe, page);
 	else
 		page_cache_release(page);
 }
@@ -401,16 +500,13 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (bufs < pipe->buffers) {
 			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page;
 			int copied;
 
-			if (!page) {
-				page = alloc_page(GFP_HIGHUSER);
-				if (unlikely(!page)) {
-					ret = ret ? : -ENOMEM;
-					break;
-				}
-				pipe->tmp_page = page;
+			page = pipe_get_page(pipe);
+			if (unlikely(!page)) {
+				ret = ret ? : -ENOMEM;
+				break;
 			}
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
@@ -420,6 +516,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			do_wakeup = 1;
 			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
 			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+				pipe_put_page(pipe, page);
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -437,7 +534,6 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			}
 			pipe->nrbufs = ++bufs;
-			pipe->tmp_page = NULL;
 
 			if (!iov_iter_count(from))
 				break;
@@ -629,6 +725,7 @@ struct pipe_inode_info *alloc_pipe_info(void)
 			pipe->user = user;
 			account_pipe_buffers(pipe, 0, pipe_bufs);
 			mutex_init(&pipe->mutex);
+			INIT_LIST_HEAD(&pipe->pool_list);
 			return pipe;
 		}
 		free_uid(user);
@@ -644,13 +741,22 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 
 	account_pipe_buffers(pipe, pipe->buffers, 0);
 	free_uid(pipe->user);
+
+	/* Keep the shrinker off the pool while the buffers go back to it */
+	mutex_lock(&pipe->mutex);
 	for (i = 0; i < pipe->buffers; i++) {
 		struct pipe_buffer *buf = pipe->bufs + i;
 		if (buf->ops)
 			buf->ops->release(pipe, buf);
 	}
-	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+	mutex_unlock(&pipe->mutex);
+
+	spin_lock(&pipe_pools_lock);
+	list_del_init(&pipe->pool_list);
+	spin_unlock(&pipe_pools_lock);
+	pipe_drain_pages(pipe, 0);
+	if (pipe->notifier)
+		splice_put_notifier(pipe->notifier);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1037,6 +1143,7 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
 	pipe->buffers = nr_pages;
+	pipe_drain_pages(pipe, pipe_pool_size(pipe));
 	return nr_pages * PAGE_SIZE;
 }
 
@@ -1116,6 +1223,9 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 	case F_GETPIPE_SZ:
 		ret = pipe->buffers * PAGE_SIZE;
 		break;
+	case F_SETPIPE_NOTIFY:
+		ret = splice_set_notifier(pipe, (int) arg);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -1161,6 +1271,8 @@ static int __init init_pipe_fs(void)
 			unregister_filesystem(&pipe_fs_type);
 		}
 	}
+	if (!err)
+		register_shrinker(&pipe_pool_shrinker);
 	return err;
 }
 
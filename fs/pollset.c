@@ -0,0 +1,534 @@
+/*
+ *  fs/pollset.c
+ *
+ *  Persistent poll sets.
+ *
+ *  poll() sets up a wait queue entry on every file it is given and tears
+ *  them all down again before it returns, so a process which polls the
+ *  same few thousand descriptors over and over pays for all of them on
+ *  every call.  A poll set is a file that remembers the descriptor array
+ *  between calls:
+ *
+ *	psfd = pollset_create(0);
+ *	for (;;) {
+ *		n = pollset_poll(psfd, fds, nfds, timeout);
+ *		...
+ *	}
+ *
+ *  pollset_poll() has the semantics of poll() on the same array, but only
+ *  entries whose fd or events changed since the previous call get
+ *  registered again, and only the files which saw a wakeup (or were found
+ *  ready last time) are polled.  The array still has to be read every
+ *  call; revents are written back only where they changed.
+ *
+ *  A set remembers one array at a time, and it is the caller's job not to
+ *  use a set from several threads at once; concurrent callers are simply
+ *  serialized.  The set holds a reference on each file in it, so a file
+ *  closed by the application is only released at the next pollset_poll()
+ *  call (or when the set itself is closed).  Poll sets cannot be put in a
+ *  poll set: such entries get POLLNVAL.
+ */
+
+#include <linux/file.h>
+#include <linux/fdtable.h>
+#include <linux/poll.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/hrtimer.h>
+#include <linux/freezer.h>
+#include <linux/anon_inodes.h>
+#include <linux/syscalls.h>
+
+#include <asm/uaccess.h>
+
+struct pollset {
+	/* Serializes pollset_poll() callers, protects the entries */
+	struct mutex mutex;
+
+	/* Waiters, wq.lock also protects the ready list */
+	wait_queue_head_t wq;
+
+	/* Entries which saw a wakeup or were ready at the last scan */
+	struct list_head ready;
+
+	/* Entry for each index of the user's array, NULL for unused ones */
+	struct pollset_entry **entries;
+	unsigned int nr;
+};
+
+struct pollset_entry {
+	struct pollset *ps;
+	struct list_head ready_link;
+
+	/* What the user asked for, and the file the fd pointed to then */
+	int fd;
+	unsigned int events;
+	struct file *file;
+
+	/* Wait queues the file's ->poll() put us on */
+	struct pollset_wait *waits;
+	bool nomem;
+
+	/* revents as found in the user's array, and the new ones */
+	short urevents;
+	short revents;
+};
+
+struct pollset_wait {
+	wait_queue_t wait;
+	wait_queue_head_t *whead;
+	struct pollset_entry *entry;
+	struct pollset_wait *next;
+};
+
+struct pollset_pqueue {
+	poll_table pt;
+	struct pollset_entry *entry;
+};
+
+/* Number of pollfds read from user space at a time */
+#define PS_BATCH	32
+
+static int pollset_wakeup(wait_queue_t *wait, unsigned mode, int sync,
+			  void *key)
+{
+	struct pollset_wait *pw = container_of(wait, struct pollset_wait, wait);
+	struct pollset_entry *entry = pw->entry;
+	struct pollset *ps = entry->ps;
+	unsigned long flags;
+
+	if (!key || ((unsigned long)key & (entry->events | POLLFREE))) {
+		spin_lock_irqsave(&ps->wq.lock, flags);
+		if (list_empty(&entry->ready_link))
+			list_add_tail(&entry->ready_link, &ps->ready);
+		wake_up_locked(&ps->wq);
+		spin_unlock_irqrestore(&ps->wq.lock, flags);
+	}
+
+	if ((unsigned long)key & POLLFREE) {
+		/*
+		 * The wait queue head is going away.  As in epoll, we may
+		 * race with pollset_remove_wait_queue(), so don't use
+		 * __remove_wait_queue(); whead->lock is held by the caller.
+		 */
+		list_del_init(&wait->task_list);
+		smp_store_release(&pw->whead, NULL);
+	}
+	return 1;
+}
+
+static void pollset_queue_proc(struct file *file, wait_queue_head_t *whead,
+			       poll_table *pt)
+{
+	struct pollset_pqueue *pq = container_of(pt, struct pollset_pqueue, pt);
+	struct pollset_entry *entry = pq->entry;
+	struct pollset_wait *pw;
+
+	pw = kmalloc(sizeof(*pw), GFP_KERNEL);
+	if (!pw) {
+		entry->nomem = true;
+		return;
+	}
+	init_waitqueue_func_entry(&pw->wait, pollset_wakeup);
+	pw->whead = whead;
+	pw->entry = entry;
+	pw->next = entry->waits;
+	entry->waits = pw;
+	add_wait_queue(whead, &pw->wait);
+}
+
+static void pollset_remove_wait_queue(struct pollset_wait *pw)
+{
+	wait_queue_head_t *whead;
+
+	rcu_read_lock();
+	/* If it is cleared by POLLFREE, it should be rcu-safe */
+	whead = smp_load_acquire(&pw->whead);
+	if (whead)
+		remove_wait_queue(whead, &pw->wait);
+	rcu_read_unlock();
+}
+
+/* Drop the registration of @entry, leaving it unused. */
+static void pollset_unregister(struct pollset_entry *entry)
+{
+	struct pollset *ps = entry->ps;
+
+	while (entry->waits) {
+		struct pollset_wait *pw = entry->waits;
+
+		entry->waits = pw->next;
+		pollset_remove_wait_queue(pw);
+		kfree(pw);
+	}
+
+	spin_lock_irq(&ps->wq.lock);
+	list_del_init(&entry->ready_link);
+	spin_unlock_irq(&ps->wq.lock);
+
+	if (entry->file)
+		fput(entry->file);
+	entry->file = NULL;
+	entry->fd = -1;
+}
+
+static unsigned int pollset_poll_file(struct pollset_entry *entry,
+				      poll_table *pt)
+{
+	struct file *file = entry->file;
+	unsigned int mask = DEFAULT_POLLMASK;
+
+	if (file->f_op->poll) {
+		pt->_key = entry->events;
+		mask = file->f_op->poll(file, pt);
+	}
+	return mask & entry->events;
+}
+
+/*
+ * Point @entry at @fd, the open file @file (which we hold a reference
+ * on now), and hook it up to the file's wait queues.
+ */
+static int pollset_register(struct pollset_entry *entry, int fd,
+			    struct file *file)
+{
+	struct pollset *ps = entry->ps;
+	struct pollset_pqueue pq = { .entry = entry };
+	unsigned int mask;
+
+	entry->fd = fd;
+	entry->file = file;
+	entry->nomem = false;
+
+	init_poll_funcptr(&pq.pt, pollset_queue_proc);
+	mask = pollset_poll_file(entry, &pq.pt);
+	if (entry->nomem) {
+		pollset_unregister(entry);
+		return -ENOMEM;
+	}
+
+	if (mask) {
+		spin_lock_irq(&ps->wq.lock);
+		if (list_empty(&entry->ready_link))
+			list_add_tail(&entry->ready_link, &ps->ready);
+		spin_unlock_irq(&ps->wq.lock);
+	}
+	return 0;
+}
+
+static void pollset_free_entries(struct pollset *ps, unsigned int from)
+{
+	unsigned int i;
+
+	for (i = from; i < ps->nr; i++) {
+		struct pollset_entry *entry = ps->entries[i];
+
+		if (!entry)
+			continue;
+		pollset_unregister(entry);
+		kfree(entry);
+		ps->entries[i] = NULL;
+	}
+}
+
+/* Make room for exactly @nfds entries. */
+static int pollset_resize(struct pollset *ps, unsigned int nfds)
+{
+	struct pollset_entry **entries = NULL;
+	size_t size = nfds * sizeof(*entries);
+
+	if (nfds == ps->nr)
+		return 0;
+
+	if (nfds) {
+		if (size <= PAGE_SIZE)
+			entries = kzalloc(size, GFP_KERNEL);
+		else
+			entries = vzalloc(size);
+		if (!entries)
+			return -ENOMEM;
+	}
+
+	pollset_free_entries(ps, nfds);
+	if (nfds && ps->nr)
+		memcpy(entries, ps->entries,
+		       min(nfds, ps->nr) * sizeof(*entries));
+	kvfree(ps->entries);
+	ps->entries = entries;
+	ps->nr = nfds;
+	return 0;
+}
+
+/*
+ * Bring the set in line with the user's array and note which revents it
+ * holds.  Returns the number of invalid descriptors, or an error.
+ */
+static const struct file_operations pollset_fops;
+
+static int pollset_sync(struct pollset *ps, struct pollfd __user *ufds)
+{
+	struct pollfd fds[PS_BATCH];
+	unsigned int i, j, len;
+	int nval = 0, err;
+
+	for (i = 0; i < ps->nr; i += len) {
+		len = min_t(unsigned int, ps->nr - i, PS_BATCH);
+		if (copy_from_user(fds, ufds + i, len * sizeof(*fds)))
+			return -EFAULT;
+
+		for (j = 0; j < len; j++) {
+			struct pollset_entry *entry = ps->entries[i + j];
+			unsigned int events;
+			struct file *file;
+			int fd = fds[j].fd;
+
+			if (fd < 0) {
+				if (entry) {
+					if (entry->fd >= 0)
+						pollset_unregister(entry);
+					entry->revents = entry->urevents = 0;
+				}
+				if (fds[j].revents &&
+				    __put_user(0, &ufds[i + j].revents))
+					return -EFAULT;
+				continue;
+			}
+
+			if (!entry) {
+				entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+				if (!entry)
+					return -ENOMEM;
+				entry->ps = ps;
+				entry->fd = -1;
+				INIT_LIST_HEAD(&entry->ready_link);
+				ps->entries[i + j] = entry;
+			}
+			entry->urevents = fds[j].revents;
+			entry->revents = 0;
+
+			events = fds[j].events | POLLERR | POLLHUP;
+			if (events != entry->events) {
+				/* Re-check it against the new mask */
+				entry->events = events;
+				if (entry->file) {
+					spin_lock_irq(&ps->wq.lock);
+					if (list_empty(&entry->ready_link))
+						list_add_tail(&entry->ready_link,
+							      &ps->ready);
+					spin_unlock_irq(&ps->wq.lock);
+				}
+			}
+
+			/* Same descriptor, same open file: nothing to do */
+			rcu_read_lock();
+			file = fcheck(fd);
+			rcu_read_unlock();
+			if (fd == entry->fd && file && file == entry->file)
+				continue;
+
+			if (entry->fd >= 0)
+				pollset_unregister(entry);
+			file = fget(fd);
+			/*
+			 * A set holding a reference on itself, directly or
+			 * through other sets, would never be released.
+			 */
+			if (file && file->f_op == &pollset_fops) {
+				fput(file);
+				file = NULL;
+			}
+			if (!file) {
+				entry->revents = POLLNVAL;
+				nval++;
+				continue;
+			}
+			err = pollset_register(entry, fd, file);
+			if (err)
+				return err;
+		}
+	}
+	return nval;
+}
+
+/* Re-poll the entries on the ready list, returns how many are ready. */
+static int pollset_scan(struct pollset *ps)
+{
+	struct pollset_entry *entry;
+	LIST_HEAD(txlist);
+	poll_table pt;
+	int count = 0;
+
+	init_poll_funcptr(&pt, NULL);
+
+	spin_lock_irq(&ps->wq.lock);
+	list_splice_init(&ps->ready, &txlist);
+	while (!list_empty(&txlist)) {
+		unsigned int mask;
+
+		entry = list_first_entry(&txlist, struct pollset_entry,
+					 ready_link);
+		/* A wakeup from now on queues it again */
+		list_del_init(&entry->ready_link);
+		spin_unlock_irq(&ps->wq.lock);
+
+		mask = pollset_poll_file(entry, &pt);
+
+		spin_lock_irq(&ps->wq.lock);
+		if (mask) {
+			/* Level triggered: look at it again next time */
+			entry->revents = mask;
+			count++;
+			if (list_empty(&entry->ready_link))
+				list_add_tail(&entry->ready_link, &ps->ready);
+		}
+	}
+	spin_unlock_irq(&ps->wq.lock);
+	return count;
+}
+
+static int pollset_wait(struct pollset *ps, int nval,
+			struct timespec *end_time)
+{
+	ktime_t expire, *to = NULL;
+	unsigned long slack = 0;
+	int timed_out = 0, count;
+	wait_queue_t wait;
+
+	/* Optimise the no-wait case */
+	if (end_time && !end_time->tv_sec && !end_time->tv_nsec)
+		timed_out = 1;
+	if (end_time && !timed_out) {
+		slack = select_estimate_accuracy(end_time);
+		expire = timespec_to_ktime(*end_time);
+		to = &expire;
+	}
+
+	for (;;) {
+		count = nval + pollset_scan(ps);
+		if (count || timed_out)
+			break;
+		if (signal_pending(current))
+			return -EINTR;
+
+		init_waitqueue_entry(&wait, current);
+		spin_lock_irq(&ps->wq.lock);
+		__add_wait_queue(&ps->wq, &wait);
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (list_empty(&ps->ready)) {
+			spin_unlock_irq(&ps->wq.lock);
+			if (!freezable_schedule_hrtimeout_range(to, slack,
+							HRTIMER_MODE_ABS))
+				timed_out = 1;
+			spin_lock_irq(&ps->wq.lock);
+		}
+		__set_current_state(TASK_RUNNING);
+		__remove_wait_queue(&ps->wq, &wait);
+		spin_unlock_irq(&ps->wq.lock);
+	}
+	return count;
+}
+
+static int pollset_release(struct inode *inode, struct file *file)
+{
+	struct pollset *ps = file->private_data;
+
+	pollset_free_entries(ps, 0);
+	kvfree(ps->entries);
+	kfree(ps);
+	return 0;
+}
+
+static const struct file_operations pollset_fops = {
+	.release	= pollset_release,
+	.llseek		= noop_llseek,
+};
+
+SYSCALL_DEFINE1(pollset_create, int, flags)
+{
+	struct pollset *ps;
+	int fd;
+
+	if (flags & ~O_CLOEXEC)
+		return -EINVAL;
+
+	ps = kzalloc(sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return -ENOMEM;
+	mutex_init(&ps->mutex);
+	init_waitqueue_head(&ps->wq);
+	INIT_LIST_HEAD(&ps->ready);
+
+	fd = anon_inode_getfd("[pollset]", &pollset_fops, ps,
+			      O_RDWR | (flags & O_CLOEXEC));
+	if (fd < 0)
+		kfree(ps);
+	return fd;
+}
+
+SYSCALL_DEFINE4(pollset_poll, int, psfd, struct pollfd __user *, ufds,
+		unsigned int, nfds, int, timeout_msecs)
+{
+	struct timespec end_time, *to = NULL;
+	struct pollset *ps;
+	struct fd f;
+	unsigned int i;
+	int ret;
+
+	if (nfds > rlimit(RLIMIT_NOFILE))
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, ufds, nfds * sizeof(*ufds)))
+		return -EFAULT;
+
+	if (timeout_msecs >= 0) {
+		to = &end_time;
+		poll_select_set_timeout(to, timeout_msecs / MSEC_PER_SEC,
+			NSEC_PER_MSEC * (timeout_msecs % MSEC_PER_SEC));
+	}
+
+	f = fdget(psfd);
+	if (!f.file)
+		return -EBADF;
+	ret = -EINVAL;
+	if (f.file->f_op != &pollset_fops)
+		goto out;
+	ps = f.file->private_data;
+
+	ret = mutex_lock_interruptible(&ps->mutex);
+	if (ret)
+		goto out;
+
+	ret = pollset_resize(ps, nfds);
+	if (!ret)
+		ret = pollset_sync(ps, ufds);
+	if (ret >= 0)
+		ret = pollset_wait(ps, ret, to);
+
+	/* Write back the revents that differ from what the user has */
+	for (i = 0; ret >= 0 && i < ps->nr; i++) {
+		struct pollset_entry *entry = ps->entries[i];
+
+		if (!entry || entry->revents == entry->urevents)
+			continue;
+		if (__put_user(entry->revents, &ufds[i].revents))
+			ret = -EFAULT;
+	}
+	mutex_unlock(&ps->mutex);
+
+	/*
+	 * Without a timeout we can restart unless a handler ran; with one we
+	 * would have to remember the time left, so let the caller see -EINTR.
+	 */
+	if (ret == -EINTR && !to)
+		ret = -ERESTARTNOHAND;
+out:
+	fdput(f);
+	return ret;
+}
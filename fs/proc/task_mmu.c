@@ -509,7 +509,8 @@ static void smaps_pmd_entry(pmd_t *pmd, unsigned long addr,
 	page = follow_trans_huge_pmd(vma, addr, pmd, FOLL_DUMP);
 	if (IS_ERR_OR_NULL(page))
 		return;
-	mss->anonymous_thp += HPAGE_PMD_SIZE;
+	if (PageAnon(page))
+		mss->anonymous_thp += HPAGE_PMD_SIZE;
 	smaps_account(mss, page, HPAGE_PMD_SIZE,
 			pmd_young(*pmd), pmd_dirty(*pmd));
 }
@@ -704,6 +705,154 @@ const struct file_operations proc_tid_smaps_operations = {
 	.release	= proc_map_release,
 };
 
+/*
+ * smaps_rollup: the totals of smaps over all the vmas of the mm, gathered
+ * in one walk without formatting a record per vma.  The walk backs off
+ * mmap_sem whenever somebody is waiting for it, so that reading a process
+ * with many mappings does not stall its page faults and mmaps; the vmas
+ * from where it stopped on are then looked up again.
+ */
+static int show_smaps_rollup(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct mm_struct *mm = priv->mm;
+	struct vm_area_struct *vma;
+	struct mem_size_stats mss;
+	struct mm_walk smaps_walk = {
+		.pmd_entry = smaps_pte_range,
+		.mm = mm,
+		.private = &mss,
+	};
+	unsigned long start = 0, last_vma_end = 0, size = 0;
+	u64 pss_locked = 0;
+	int ret = 0;
+
+	priv->task = get_proc_task(priv->inode);
+	if (!priv->task)
+		return -ESRCH;
+
+	if (!mm || !atomic_inc_not_zero(&mm->mm_users))
+		goto out_put_task;
+
+	memset(&mss, 0, sizeof(mss));
+	down_read(&mm->mmap_sem);
+	vma = mm->mmap;
+	if (vma)
+		start = vma->vm_start;
+	while (vma) {
+		unsigned long addr = max(vma->vm_start, last_vma_end);
+		u64 pss = mss.pss;
+
+		/* Part of it may have been walked before mmap_sem was dropped */
+		if (addr == vma->vm_start)
+			walk_page_vma(vma, &smaps_walk);
+		else
+			walk_page_range(addr, vma->vm_end, &smaps_walk);
+		size += vma->vm_end - addr;
+		if (vma->vm_flags & VM_LOCKED)
+			pss_locked += mss.pss - pss;
+		last_vma_end = vma->vm_end;
+
+		if (rwsem_is_contended(&mm->mmap_sem)) {
+			up_read(&mm->mmap_sem);
+			if (fatal_signal_pending(current)) {
+				ret = -EINTR;
+				goto out_mmput;
+			}
+			cond_resched();
+			down_read(&mm->mmap_sem);
+			vma = find_vma(mm, last_vma_end);
+			continue;
+		}
+		vma = vma->vm_next;
+	}
+	up_read(&mm->mmap_sem);
+
+	seq_setwidth(m, 25 + sizeof(void *) * 6 - 1);
+	seq_printf(m, "%08lx-%08lx ---p %08lx %02x:%02x %lu ",
+		   start, last_vma_end, 0UL, 0, 0, 0UL);
+	seq_pad(m, ' ');
+	seq_puts(m, "[rollup]\n");
+	seq_printf(m,
+		   "Size:           %8lu kB\n"
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Shared_Clean:   %8lu kB\n"
+		   "Shared_Dirty:   %8lu kB\n"
+		   "Private_Clean:  %8lu kB\n"
+		   "Private_Dirty:  %8lu kB\n"
+		   "Referenced:     %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "AnonHugePages:  %8lu kB\n"
+		   "Swap:           %8lu kB\n"
+		   "Locked:         %8lu kB\n",
+		   size >> 10,
+		   mss.resident >> 10,
+		   (unsigned long)(mss.pss >> (10 + PSS_SHIFT)),
+		   mss.shared_clean  >> 10,
+		   mss.shared_dirty  >> 10,
+		   mss.private_clean >> 10,
+		   mss.private_dirty >> 10,
+		   mss.referenced >> 10,
+		   mss.anonymous >> 10,
+		   mss.anonymous_thp >> 10,
+		   mss.swap >> 10,
+		   (unsigned long)(pss_locked >> (10 + PSS_SHIFT)));
+
+out_mmput:
+	mmput(mm);
+out_put_task:
+	put_task_struct(priv->task);
+	priv->task = NULL;
+	return ret;
+}
+
+static int smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	struct proc_maps_private *priv;
+	int ret;
+
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	ret = single_open(file, show_smaps_rollup, priv);
+	if (ret)
+		goto out_free;
+
+	priv->inode = inode;
+	priv->mm = proc_mem_open(inode, PTRACE_MODE_READ);
+	if (IS_ERR(priv->mm)) {
+		ret = PTR_ERR(priv->mm);
+		single_release(inode, file);
+		goto out_free;
+	}
+	return 0;
+
+out_free:
+	kfree(priv);
+	return ret;
+}
+
+static int smaps_rollup_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *seq = file->private_data;
+	struct proc_maps_private *priv = seq->private;
+
+	if (priv->mm)
+		mmdrop(priv->mm);
+
+	kfree(priv);
+	return single_release(inode, file);
+}
+
+const struct file_operations proc_pid_smaps_rollup_operations = {
+	.open		= smaps_rollup_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= smaps_rollup_release,
+};
+
 /*
  * We do not want to have constant page-shift bits sitting in
  * pagemap entries and are about to reuse them some time soon.
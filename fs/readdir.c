@@ -18,6 +18,11 @@
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/slab.h>
+#include <linux/fs_struct.h>
+#include <linux/readdirplus.h>
 
 #include <asm/uaccess.h>
 
@@ -307,3 +312,280 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	fdput(f);
 	return error;
 }
+
+/*
+ * readdirplus() is getdents64() with (a selection of) the attributes that
+ * lstat() would return for each entry, which saves an fstatat() and its
+ * path walk per entry.
+ *
+ * The actor only collects the names into a kernel buffer: ->iterate() may
+ * be holding file system locks or mapped pages while it calls us, so we
+ * cannot call back into the file system from there.  The entries are
+ * looked up and stat'ed once iterate_dir() has returned.  The batch is
+ * bounded, so a call may return fewer entries than would fit in the user
+ * buffer; the caller just keeps calling until it gets 0, as for getdents.
+ */
+#define RDP_BATCH_SIZE	(32 * 1024)
+
+struct rdp_entry {
+	u64		ino;
+	loff_t		offset;
+	unsigned short	namlen;
+	unsigned char	d_type;
+	char		name[0];
+};
+
+struct readdirplus_callback {
+	struct dir_context ctx;
+	char *batch;
+	unsigned int size;
+	unsigned int used;
+	unsigned int nr;
+	unsigned int stat_size;
+	int count;
+	int error;
+};
+
+static inline unsigned int rdp_entry_len(int namlen)
+{
+	return ALIGN(offsetof(struct rdp_entry, name) + namlen + 1,
+		     sizeof(u64));
+}
+
+static inline unsigned int rdp_reclen(unsigned int stat_size, int namlen)
+{
+	return ALIGN(sizeof(struct linux_dirent_plus) + stat_size + namlen + 1,
+		     sizeof(u64));
+}
+
+static int fillrdp(struct dir_context *ctx, const char *name, int namlen,
+		   loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct readdirplus_callback *buf =
+		container_of(ctx, struct readdirplus_callback, ctx);
+	int reclen = rdp_reclen(buf->stat_size, namlen);
+	unsigned int len = rdp_entry_len(namlen);
+	struct rdp_entry *entry;
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count || len > buf->size - buf->used)
+		return -EINVAL;
+	entry = (struct rdp_entry *)(buf->batch + buf->used);
+	entry->ino = ino;
+	entry->offset = offset;
+	entry->namlen = namlen;
+	entry->d_type = d_type;
+	memcpy(entry->name, name, namlen);
+	entry->name[namlen] = 0;
+	buf->used += len;
+	buf->nr++;
+	buf->count -= reclen;
+	return 0;
+}
+
+/* Find the parent of @path the way ".." would. */
+static void rdp_dotdot(struct path *path)
+{
+	struct path root;
+	struct dentry *parent;
+
+	get_fs_root(current->fs, &root);
+	while (!path_equal(path, &root) &&
+	       path->dentry == path->mnt->mnt_root) {
+		if (!follow_up(path))
+			break;
+	}
+	if (!path_equal(path, &root)) {
+		parent = dget_parent(path->dentry);
+		dput(path->dentry);
+		path->dentry = parent;
+	}
+	path_put(&root);
+}
+
+static struct dentry *rdp_lookup(struct dentry *parent, struct rdp_entry *entry)
+{
+	struct inode *dir = d_inode(parent);
+	struct qstr this = QSTR_INIT(entry->name, entry->namlen);
+	struct dentry *dentry;
+
+	/* Usually the child is in the dcache and needs no revalidation */
+	dentry = d_hash_and_lookup(parent, &this);
+	if (IS_ERR(dentry))
+		return dentry;
+	if (dentry) {
+		if (!(dentry->d_flags & DCACHE_OP_REVALIDATE))
+			return dentry;
+		dput(dentry);
+	}
+
+	mutex_lock(&dir->i_mutex);
+	dentry = lookup_one_len(entry->name, parent, entry->namlen);
+	mutex_unlock(&dir->i_mutex);
+	return dentry;
+}
+
+static int rdp_getattr(struct file *file, struct rdp_entry *entry,
+		       struct kstat *stat)
+{
+	struct path path;
+	int error;
+
+	path = file->f_path;
+	path_get(&path);
+	if (entry->name[0] == '.' && entry->namlen <= 2 &&
+	    entry->name[entry->namlen - 1] == '.') {
+		if (entry->namlen == 2)
+			rdp_dotdot(&path);
+	} else {
+		struct dentry *dentry = rdp_lookup(path.dentry, entry);
+
+		if (IS_ERR(dentry)) {
+			error = PTR_ERR(dentry);
+			goto out;
+		}
+		dput(path.dentry);
+		path.dentry = dentry;
+		error = -ENOENT;
+		if (d_is_negative(dentry))
+			goto out;
+	}
+
+	while (d_mountpoint(path.dentry) && follow_down_one(&path))
+		;
+	error = vfs_getattr(&path, stat);
+out:
+	path_put(&path);
+	return error;
+}
+
+static void rdp_fill_stat(struct rdp_stat *st, struct kstat *stat,
+			  unsigned int mask)
+{
+	memset(st, 0, sizeof(*st));
+	if (mask & RDP_MODE)
+		st->st_mode = stat->mode;
+	if (mask & RDP_NLINK)
+		st->st_nlink = stat->nlink;
+	if (mask & RDP_UID)
+		st->st_uid = from_kuid_munged(current_user_ns(), stat->uid);
+	if (mask & RDP_GID)
+		st->st_gid = from_kgid_munged(current_user_ns(), stat->gid);
+	if (mask & RDP_DEV)
+		st->st_dev = new_encode_dev(stat->dev);
+	if (mask & RDP_RDEV)
+		st->st_rdev = new_encode_dev(stat->rdev);
+	if (mask & RDP_INO)
+		st->st_ino = stat->ino;
+	if (mask & RDP_SIZE)
+		st->st_size = stat->size;
+	if (mask & RDP_BLOCKS) {
+		st->st_blocks = stat->blocks;
+		st->st_blksize = stat->blksize;
+	}
+	if (mask & RDP_ATIME) {
+		st->st_atim.tv_sec = stat->atime.tv_sec;
+		st->st_atim.tv_nsec = stat->atime.tv_nsec;
+	}
+	if (mask & RDP_MTIME) {
+		st->st_mtim.tv_sec = stat->mtime.tv_sec;
+		st->st_mtim.tv_nsec = stat->mtime.tv_nsec;
+	}
+	if (mask & RDP_CTIME) {
+		st->st_ctim.tv_sec = stat->ctime.tv_sec;
+		st->st_ctim.tv_nsec = stat->ctime.tv_nsec;
+	}
+}
+
+/* Look up the collected entries and write them out to user space. */
+static int rdp_copy_out(struct file *file, struct readdirplus_callback *buf,
+			struct linux_dirent_plus __user *dirent,
+			unsigned int mask)
+{
+	struct rdp_entry *entry = (struct rdp_entry *)buf->batch;
+	struct rdp_entry *next;
+	int search = 0;
+	unsigned int i;
+
+	/* The fast dcache path skips the search permission check */
+	if (mask)
+		search = inode_permission(file_inode(file), MAY_EXEC);
+
+	for (i = 0; i < buf->nr; i++, entry = next) {
+		struct linux_dirent_plus de = {
+			.d_ino = entry->ino,
+			.d_type = entry->d_type,
+		};
+		struct rdp_stat st;
+		struct kstat stat;
+		void __user *p = dirent;
+
+		next = (void *)entry + rdp_entry_len(entry->namlen);
+		de.d_off = i + 1 < buf->nr ? next->offset : buf->ctx.pos;
+		de.d_reclen = rdp_reclen(buf->stat_size, entry->namlen);
+		de.d_name_off = sizeof(de) + buf->stat_size;
+
+		if (mask) {
+			de.d_error = search ?: rdp_getattr(file, entry, &stat);
+			if (!de.d_error) {
+				de.d_mask = mask;
+				rdp_fill_stat(&st, &stat, mask);
+			} else {
+				memset(&st, 0, sizeof(st));
+			}
+		}
+
+		if (copy_to_user(p, &de, sizeof(de)))
+			return -EFAULT;
+		p += sizeof(de);
+		if (mask && copy_to_user(p, &st, sizeof(st)))
+			return -EFAULT;
+		p += buf->stat_size;
+		if (copy_to_user(p, entry->name, entry->namlen + 1))
+			return -EFAULT;
+		dirent = (void __user *)dirent + de.d_reclen;
+		cond_resched();
+	}
+	return 0;
+}
+
+SYSCALL_DEFINE4(readdirplus, unsigned int, fd,
+		struct linux_dirent_plus __user *, dirent, unsigned int, count,
+		unsigned int, mask)
+{
+	struct fd f;
+	struct readdirplus_callback buf = {
+		.ctx.actor = fillrdp,
+		.count = count,
+		.stat_size = mask ? sizeof(struct rdp_stat) : 0,
+	};
+	int error;
+
+	if (mask & ~RDP_ALL)
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		return -EFAULT;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	buf.size = min_t(unsigned int, count, RDP_BATCH_SIZE);
+	buf.batch = kmalloc(buf.size, GFP_KERNEL);
+	error = -ENOMEM;
+	if (!buf.batch)
+		goto out;
+
+	error = iterate_dir(f.file, &buf.ctx);
+	if (error >= 0)
+		error = buf.error;
+	if (buf.nr) {
+		error = rdp_copy_out(f.file, &buf, dirent, mask);
+		if (!error)
+			error = count - buf.count;
+	}
+	kfree(buf.batch);
+out:
+	fdput(f);
+	return error;
+}
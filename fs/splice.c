@@ -32,6 +32,8 @@
 #include <linux/gfp.h>
 #include <linux/socket.h>
 #include <linux/compat.h>
+#include <linux/eventfd.h>
+#include <linux/workqueue.h>
 #include "internal.h"
 
 /*
@@ -400,6 +402,7 @@ __generic_file_splice_read(struct file *in, loff_t *ppos,
 		this_len = min_t(unsigned long, len, PAGE_CACHE_SIZE - loff);
 		page = spd.pages[page_nr];
 
+		page_cache_ra_used(mapping, page);
 		if (PageReadahead(page))
 			page_cache_async_readahead(mapping, &in->f_ra, in,
 					page, index, req_pages - page_nr);
@@ -1586,6 +1589,275 @@ static long vmsplice_to_user(struct file *file, const struct iovec __user *uiov,
 	return ret;
 }
 
+/*
+ * Completion notification for vmsplice(SPLICE_F_NOTIFY).
+ *
+ * Once user pages have been spliced into a pipe, the pipe buffers and
+ * whatever the data is spliced on to (typically skbs sitting in a socket
+ * send or retransmit queue) hold references to them, and user space must
+ * not touch the memory until all of those are gone.  There is no hook for
+ * "last skb frag reference dropped", so instead each notifying vmsplice()
+ * keeps its own reference to the pages it spliced, and a worker checks
+ * when that and the user mappings are the only references left - the same
+ * test KSM uses to find pages with outstanding GUP or DMA references.
+ * Completed calls are reported by adding to the pipe's eventfd, in the
+ * order they were made.
+ */
+struct splice_notifier {
+	atomic_t		count;
+	spinlock_t		lock;
+	struct list_head	pending;
+	struct eventfd_ctx	*eventfd;
+	struct delayed_work	work;
+	unsigned long		delay;
+};
+
+struct splice_notify_req {
+	struct list_head	list;
+	unsigned int		nr_pages;
+	unsigned int		checks;
+	struct page		*pages[0];
+};
+
+/* Give up on per-cpu pagevecs releasing their references by themselves */
+#define SPLICE_NOTIFY_DRAIN_CHECKS	4
+
+void splice_put_notifier(struct splice_notifier *sn)
+{
+	if (atomic_dec_and_test(&sn->count)) {
+		eventfd_ctx_put(sn->eventfd);
+		kfree(sn);
+	}
+}
+
+static void splice_notify_put_pages(struct splice_notify_req *req)
+{
+	unsigned int i;
+
+	for (i = 0; i < req->nr_pages; i++)
+		page_cache_release(req->pages[i]);
+	req->nr_pages = 0;
+}
+
+static void splice_notify_free_req(struct splice_notify_req *req)
+{
+	splice_notify_put_pages(req);
+	kfree(req);
+}
+
+static bool splice_notify_req_has_page(struct splice_notify_req *req,
+				       struct page *page)
+{
+	unsigned int i;
+
+	for (i = 0; i < req->nr_pages; i++)
+		if (req->pages[i] == page)
+			return true;
+	return false;
+}
+
+/*
+ * References to @page we know about: @ours, one per mapping, and the
+ * page or swap cache.
+ */
+static int splice_notify_page_refs(struct page *page, int ours)
+{
+	int refs = page_mapcount(page) + ours;
+
+	if (PageAnon(page))
+		refs += PageSwapCache(page);
+	else if (page->mapping)
+		refs += 1 + page_has_private(page);
+	return refs;
+}
+
+/*
+ * Mappings and cache references are dropped after the state that accounts
+ * for them is torn down, and taken before it is set up, so sampling that
+ * state on both sides of the reference count catches a concurrent change
+ * that would otherwise let a foreign reference pass for a known one.
+ */
+static bool splice_notify_page_idle(struct page *page, int ours)
+{
+	int before, count;
+
+	before = splice_notify_page_refs(page, ours);
+	smp_rmb();
+	count = page_count(page);
+	smp_rmb();
+	return count <= before && splice_notify_page_refs(page, ours) == before;
+}
+
+/*
+ * A request holds one reference to each page it spliced, however often it
+ * spliced it. Requests queued after @req may have spliced @page too, and
+ * hold a reference of their own; those queued before it have completed
+ * and dropped theirs. Called with sn->lock held.
+ */
+static int splice_notify_page_ours(struct splice_notifier *sn,
+				   struct splice_notify_req *req,
+				   struct page *page)
+{
+	int ours = 1;
+
+	list_for_each_entry_continue(req, &sn->pending, list)
+		ours += splice_notify_req_has_page(req, page);
+	return ours;
+}
+
+static bool splice_notify_req_idle(struct splice_notifier *sn,
+				   struct splice_notify_req *req)
+{
+	unsigned int i;
+
+	for (i = 0; i < req->nr_pages; i++) {
+		struct page *page = req->pages[i];
+
+		/* Only look for later requests when the page looks busy */
+		if (!splice_notify_page_idle(page, 1) &&
+		    !splice_notify_page_idle(page,
+				splice_notify_page_ours(sn, req, page)))
+			return false;
+	}
+	return true;
+}
+
+static void splice_notify_work(struct work_struct *work)
+{
+	struct splice_notifier *sn = container_of(to_delayed_work(work),
+						  struct splice_notifier, work);
+	struct splice_notify_req *req, *tmp;
+	LIST_HEAD(done);
+	unsigned int nr = 0;
+
+	spin_lock(&sn->lock);
+	list_for_each_entry_safe(req, tmp, &sn->pending, list) {
+		if (!splice_notify_req_idle(sn, req)) {
+			/*
+			 * Freshly faulted pages sit in a per-cpu pagevec,
+			 * with a reference, until something drains it.
+			 */
+			if (++req->checks == SPLICE_NOTIFY_DRAIN_CHECKS) {
+				spin_unlock(&sn->lock);
+				lru_add_drain_all();
+				spin_lock(&sn->lock);
+			}
+			break;
+		}
+		/* The next request's test counts on our references being gone */
+		splice_notify_put_pages(req);
+		list_move_tail(&req->list, &done);
+		nr++;
+	}
+
+	if (!list_empty(&sn->pending)) {
+		sn->delay = nr ? 1 : min_t(unsigned long, sn->delay * 2, HZ);
+		schedule_delayed_work(&sn->work, sn->delay);
+	}
+	spin_unlock(&sn->lock);
+
+	if (!nr)
+		return;
+
+	eventfd_signal(sn->eventfd, nr);
+	list_for_each_entry_safe(req, tmp, &done, list) {
+		splice_notify_free_req(req);
+		splice_put_notifier(sn);
+	}
+}
+
+static void splice_notify_queue(struct splice_notifier *sn,
+				struct splice_notify_req *req)
+{
+	spin_lock(&sn->lock);
+	if (list_empty(&sn->pending)) {
+		sn->delay = 1;
+		schedule_delayed_work(&sn->work, sn->delay);
+	}
+	list_add_tail(&req->list, &sn->pending);
+	spin_unlock(&sn->lock);
+}
+
+/*
+ * Called with the pipe locked, from fcntl(F_SETPIPE_NOTIFY). Requests
+ * already queued keep reporting to the eventfd they were made against.
+ */
+long splice_set_notifier(struct pipe_inode_info *pipe, int fd)
+{
+	struct splice_notifier *sn = NULL;
+
+	if (fd >= 0) {
+		struct eventfd_ctx *eventfd;
+
+		eventfd = eventfd_ctx_fdget(fd);
+		if (IS_ERR(eventfd))
+			return PTR_ERR(eventfd);
+
+		sn = kzalloc(sizeof(*sn), GFP_KERNEL);
+		if (!sn) {
+			eventfd_ctx_put(eventfd);
+			return -ENOMEM;
+		}
+		atomic_set(&sn->count, 1);
+		spin_lock_init(&sn->lock);
+		INIT_LIST_HEAD(&sn->pending);
+		INIT_DELAYED_WORK(&sn->work, splice_notify_work);
+		sn->eventfd = eventfd;
+	} else if (fd != -1) {
+		return -EBADF;
+	}
+
+	if (pipe->notifier)
+		splice_put_notifier(pipe->notifier);
+	pipe->notifier = sn;
+	return 0;
+}
+
+/*
+ * Prepare the pages of a notifying vmsplice() for tracking. Compound pages
+ * are replaced by private copies, as their reference counts cannot be
+ * tied to a single user mapping, and the zero page is never written to,
+ * so neither needs tracking.
+ */
+static struct splice_notify_req *
+splice_notify_prepare(struct splice_pipe_desc *spd)
+{
+	struct splice_notify_req *req;
+	unsigned int i;
+
+	req = kmalloc(sizeof(*req) + spd->nr_pages * sizeof(struct page *),
+		      GFP_KERNEL);
+	if (!req)
+		return NULL;
+	req->nr_pages = 0;
+	req->checks = 0;
+
+	for (i = 0; i < spd->nr_pages; i++) {
+		struct page *page = spd->pages[i];
+
+		if (PageCompound(page)) {
+			struct page *copy = alloc_page(GFP_HIGHUSER);
+
+			if (!copy)
+				goto err;
+			copy_highpage(copy, page);
+			page_cache_release(page);
+			spd->pages[i] = copy;
+			continue;
+		}
+		if (is_zero_pfn(page_to_pfn(page)) ||
+		    splice_notify_req_has_page(req, page))
+			continue;
+
+		page_cache_get(page);
+		req->pages[req->nr_pages++] = page;
+	}
+	return req;
+err:
+	splice_notify_free_req(req);
+	return NULL;
+}
+
 /*
  * vmsplice splices a user address range into a pipe. It can be thought of
  * as splice-from-memory, where the regular splice is splice-from-file (or
@@ -1605,6 +1877,8 @@ static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 		.ops = &user_page_pipe_buf_ops,
 		.spd_release = spd_release_page,
 	};
+	struct splice_notifier *sn = NULL;
+	struct splice_notify_req *req = NULL;
 	long ret;
 
 	pipe = get_pipe_info(file);
@@ -1614,14 +1888,49 @@ static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 	if (splice_grow_spd(pipe, &spd))
 		return -ENOMEM;
 
+	if (flags & SPLICE_F_NOTIFY) {
+		pipe_lock(pipe);
+		sn = pipe->notifier;
+		if (sn)
+			atomic_inc(&sn->count);
+		pipe_unlock(pipe);
+		if (!sn) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
 	spd.nr_pages = get_iovec_page_array(iov, nr_segs, spd.pages,
 					    spd.partial, false,
 					    spd.nr_pages_max);
-	if (spd.nr_pages <= 0)
+	if (spd.nr_pages <= 0) {
 		ret = spd.nr_pages;
-	else
-		ret = splice_to_pipe(pipe, &spd);
+		goto out;
+	}
+
+	if (sn) {
+		req = splice_notify_prepare(&spd);
+		if (!req) {
+			while (spd.nr_pages)
+				spd.spd_release(&spd, --spd.nr_pages);
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	ret = splice_to_pipe(pipe, &spd);
 
+	if (req) {
+		if (ret > 0) {
+			splice_notify_queue(sn, req);
+			sn = NULL;
+		} else {
+			splice_notify_free_req(req);
+		}
+	}
+out:
+	if (sn)
+		splice_put_notifier(sn);
 	splice_shrink_spd(&spd);
 	return ret;
 }
@@ -41,6 +41,17 @@ enum wb_stat_item {
 
 #define WB_STAT_BATCH (8*(1+ilog2(nr_cpu_ids)))
 
+/*
+ * Readahead efficiency of a bdi, in pages: read ahead, used afterwards, and
+ * dropped from the page cache without ever being used.
+ */
+enum bdi_ra_stat_item {
+	BDI_RA_READ,
+	BDI_RA_USED,
+	BDI_RA_WASTED,
+	NR_BDI_RA_STAT_ITEMS
+};
+
 /*
  * For cgroup writeback, multiple wb's may map to the same blkcg.  Those
  * wb's can operate mostly independently but should share the congested
@@ -149,6 +160,8 @@ struct backing_dev_info {
 	 */
 	atomic_long_t tot_write_bandwidth;
 
+	struct percpu_counter ra_stat[NR_BDI_RA_STAT_ITEMS];
+
 	struct bdi_writeback wb;  /* the root writeback info for this bdi */
 #ifdef CONFIG_CGROUP_WRITEBACK
 	struct radix_tree_root cgwb_tree; /* radix tree of active cgroup wbs */
@@ -115,6 +115,18 @@ static inline s64 wb_stat_sum(struct bdi_writeback *wb, enum wb_stat_item item)
 
 extern void wb_writeout_inc(struct bdi_writeback *wb);
 
+static inline void bdi_ra_stat_add(struct backing_dev_info *bdi,
+				   enum bdi_ra_stat_item item, s64 amount)
+{
+	__percpu_counter_add(&bdi->ra_stat[item], amount, WB_STAT_BATCH);
+}
+
+static inline s64 bdi_ra_stat_sum(struct backing_dev_info *bdi,
+				  enum bdi_ra_stat_item item)
+{
+	return percpu_counter_sum_positive(&bdi->ra_stat[item]);
+}
+
 /*
  * maximal error of a stat counter.
  */
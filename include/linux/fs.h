@@ -636,7 +636,8 @@ struct inode {
 	unsigned long		dirtied_when;	/* jiffies of first dirtying */
 	unsigned long		dirtied_time_when;
 
-	struct hlist_node	i_hash;
+	struct hlist_bl_node	i_hash;
+	struct hlist_bl_head	*i_hash_head;	/* bucket we are hashed on */
 	struct list_head	i_wb_list;	/* backing dev IO list */
 #ifdef CONFIG_CGROUP_WRITEBACK
 	struct bdi_writeback	*i_wb;		/* the associated cgroup wb */
@@ -682,7 +683,18 @@ struct inode {
 
 static inline int inode_unhashed(struct inode *inode)
 {
-	return hlist_unhashed(&inode->i_hash);
+	return hlist_bl_unhashed(&inode->i_hash);
+}
+
+/*
+ * For file systems that keep their own inode cache, but want the VFS to
+ * treat their inodes as hashed (e.g. to keep them alive in
+ * generic_drop_inode()).  The inode is not put on any hash chain.
+ */
+static inline void inode_fake_hash(struct inode *inode)
+{
+	inode->i_hash.next = NULL;
+	inode->i_hash.pprev = &inode->i_hash.next;
 }
 
 /*
@@ -825,6 +837,8 @@ struct file_ra_state {
 
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
+	unsigned int misses;		/* readahead pages evicted unused
+					   since the window was set up */
 	loff_t prev_pos;		/* Cache last read() position */
 };
 
@@ -986,6 +1000,8 @@ struct file_lock {
 	struct file *fl_file;
 	loff_t fl_start;
 	loff_t fl_end;
+	struct rb_node fl_rb;		/* POSIX locks: node in flc_posix_tree */
+	loff_t fl_rb_subtree_last;
 
 	struct fasync_struct *	fl_fasync; /* for lease break notifications */
 	/* for lease breaks: */
@@ -1008,6 +1024,7 @@ struct file_lock_context {
 	spinlock_t		flc_lock;
 	struct list_head	flc_flock;
 	struct list_head	flc_posix;
+	struct rb_root		flc_posix_tree;	/* flc_posix by range */
 	struct list_head	flc_lease;
 };
 
@@ -1373,6 +1390,9 @@ struct super_block {
 	/* Number of inodes with nlink == 0 but still referenced */
 	atomic_long_t s_remove_count;
 
+	/* Number of negative dentries on s_dentry_lru */
+	struct percpu_counter s_nr_dentry_negative;
+
 	/* Being remounted read-only */
 	int s_readonly_remount;
 
@@ -1644,6 +1664,8 @@ struct file_operations {
 #ifndef CONFIG_MMU
 	unsigned (*mmap_capabilities)(struct file *);
 #endif
+	ssize_t (*copy_file_range)(struct file *, loff_t, struct file *,
+			loff_t, size_t, unsigned int);
 };
 
 struct inode_operations {
@@ -1703,6 +1725,8 @@ extern ssize_t vfs_readv(struct file *, const struct iovec __user *,
 		unsigned long, loff_t *);
 extern ssize_t vfs_writev(struct file *, const struct iovec __user *,
 		unsigned long, loff_t *);
+extern ssize_t vfs_copy_file_range(struct file *, loff_t, struct file *,
+				   loff_t, size_t, unsigned int);
 
 struct super_operations {
    	struct inode *(*alloc_inode)(struct super_block *sb);
@@ -1955,6 +1979,7 @@ struct file_system_type {
 #define FS_USERNS_MOUNT		8	/* Can be mounted by userns root */
 #define FS_USERNS_DEV_MOUNT	16 /* A userns mount does not imply MNT_NODEV */
 #define FS_USERNS_VISIBLE	32	/* FS must already be visible */
+#define FS_PARALLEL_LOOKUP	64	/* ->lookup() may run without i_mutex, see fs/namei.c */
 #define FS_RENAME_DOES_D_MOVE	32768	/* FS will handle d_move() during rename() internally. */
 	struct dentry *(*mount) (struct file_system_type *, int,
 		       const char *, void *);
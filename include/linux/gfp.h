@@ -310,6 +310,35 @@ static inline struct page *alloc_pages_node(int nid, gfp_t gfp_mask,
 	return __alloc_pages(gfp_mask, order, node_zonelist(nid, gfp_mask));
 }
 
+unsigned long __alloc_pages_bulk(gfp_t gfp_mask, struct zonelist *zonelist,
+				 nodemask_t *nodemask, unsigned long nr_pages,
+				 struct list_head *page_list,
+				 struct page **page_array);
+
+/*
+ * Allocate up to @nr_pages order-0 pages on the local node in one go.
+ * The _list variant adds them to @list and returns how many it added, the
+ * _array variant fills the NULL entries of @array and returns how many
+ * entries are populated.  Either may return less than asked for.
+ */
+static inline unsigned long
+alloc_pages_bulk_list(gfp_t gfp_mask, unsigned long nr_pages,
+		      struct list_head *list)
+{
+	return __alloc_pages_bulk(gfp_mask,
+				  node_zonelist(numa_node_id(), gfp_mask),
+				  NULL, nr_pages, list, NULL);
+}
+
+static inline unsigned long
+alloc_pages_bulk_array(gfp_t gfp_mask, unsigned long nr_pages,
+		       struct page **array)
+{
+	return __alloc_pages_bulk(gfp_mask,
+				  node_zonelist(numa_node_id(), gfp_mask),
+				  NULL, nr_pages, NULL, array);
+}
+
 static inline struct page *alloc_pages_exact_node(int nid, gfp_t gfp_mask,
 						unsigned int order)
 {
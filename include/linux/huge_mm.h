@@ -138,12 +138,22 @@ static inline int pmd_trans_huge_lock(pmd_t *pmd, struct vm_area_struct *vma,
 	else
 		return 0;
 }
+/*
+ * A huge pmd in a vma with vm_ops maps a naturally aligned extent of
+ * HPAGE_PMD_NR ordinary page cache pages, installed by ->pmd_fault(),
+ * rather than an anonymous compound page.
+ */
+static inline bool huge_pmd_maps_pagecache(struct vm_area_struct *vma)
+{
+	return vma->vm_ops != NULL;
+}
 static inline void vma_adjust_trans_huge(struct vm_area_struct *vma,
 					 unsigned long start,
 					 unsigned long end,
 					 long adjust_next)
 {
-	if (!vma->anon_vma || vma->vm_ops)
+	if (huge_pmd_maps_pagecache(vma) ? !vma->vm_ops->pmd_fault :
+					   !vma->anon_vma)
 		return;
 	__vma_adjust_trans_huge(vma, start, end, adjust_next);
 }
@@ -195,6 +205,10 @@ static inline int hugepage_madvise(struct vm_area_struct *vma,
 	BUG();
 	return 0;
 }
+static inline bool huge_pmd_maps_pagecache(struct vm_area_struct *vma)
+{
+	return false;
+}
 static inline void vma_adjust_trans_huge(struct vm_area_struct *vma,
 					 unsigned long start,
 					 unsigned long end,
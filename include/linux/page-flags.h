@@ -97,6 +97,7 @@ enum pageflags {
 	PG_reclaim,		/* To be reclaimed asap */
 	PG_swapbacked,		/* Page is backed by RAM/swap */
 	PG_unevictable,		/* Page is "unevictable"  */
+	PG_prefetched,		/* Read ahead, not used yet */
 #ifdef CONFIG_MMU
 	PG_mlocked,		/* Page is vma mlocked */
 #endif
@@ -246,6 +247,14 @@ PAGEFLAG(MappedToDisk, mappedtodisk)
 /* PG_readahead is only used for reads; PG_reclaim is only for writes */
 PAGEFLAG(Reclaim, reclaim) TESTCLEARFLAG(Reclaim, reclaim)
 PAGEFLAG(Readahead, reclaim) TESTCLEARFLAG(Readahead, reclaim)
+/*
+ * PG_readahead only marks the page which triggers the next readahead, while
+ * PG_prefetched is set on every page read ahead until it is first used, so
+ * that pages dropped unused can be counted.  No other bit is free on all
+ * page cache pages: the owner and private bits belong to file systems.
+ */
+PAGEFLAG(Prefetched, prefetched) __SETPAGEFLAG(Prefetched, prefetched)
+	TESTCLEARFLAG(Prefetched, prefetched)
 
 #ifdef CONFIG_HIGHMEM
 /*
@@ -15,6 +15,8 @@
 #include <linux/hardirq.h> /* for in_interrupt() */
 #include <linux/hugetlb_inline.h>
 
+struct pagevec;
+
 /*
  * Bits in mapping->flags.  The lower __GFP_BITS_SHIFT bits are the page
  * allocation mode flags.
@@ -236,6 +238,20 @@ static inline struct page *page_cache_alloc_readahead(struct address_space *x)
 				  __GFP_COLD | __GFP_NORETRY | __GFP_NOWARN);
 }
 
+extern void __page_cache_ra_used(struct address_space *mapping);
+
+/*
+ * Credit the device of @mapping with @page if it was read ahead and this is
+ * the first time it gets used.  Whoever reads pages after readahead should
+ * call this, for the read_ahead_used statistics to add up.
+ */
+static inline void page_cache_ra_used(struct address_space *mapping,
+				      struct page *page)
+{
+	if (PagePrefetched(page) && TestClearPagePrefetched(page))
+		__page_cache_ra_used(mapping);
+}
+
 typedef int filler_t(void *, struct page *);
 
 pgoff_t page_cache_next_hole(struct address_space *mapping,
@@ -650,7 +666,15 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 				pgoff_t index, gfp_t gfp_mask);
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t index, gfp_t gfp_mask);
+unsigned add_to_page_cache_lru_batch(struct page **pages, unsigned nr_pages,
+				struct address_space *mapping,
+				pgoff_t offset, gfp_t gfp_mask);
+unsigned add_to_page_cache_lru_list(struct list_head *pages,
+				struct page **batch, unsigned nr,
+				struct address_space *mapping, gfp_t gfp_mask);
 extern void delete_from_page_cache(struct page *page);
+extern void delete_from_page_cache_batch(struct address_space *mapping,
+					 struct pagevec *pvec);
 extern void __delete_from_page_cache(struct page *page, void *shadow,
 				     struct mem_cgroup *memcg);
 int replace_page_cache_page(struct page *old, struct page *new, gfp_t gfp_mask);
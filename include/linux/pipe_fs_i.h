@@ -32,7 +32,9 @@ struct pipe_buffer {
  *	@nrbufs: the number of non-empty pipe buffers in this pipe
  *	@buffers: total number of buffers (should be a power of 2)
  *	@curbuf: the current pipe buffer entry
- *	@tmp_page: cached released page
+ *	@nr_tmp_pages: number of pages in @tmp_pages
+ *	@tmp_pages: released pages kept for reuse by the writer
+ *	@pool_list: on the list of pipes with pooled pages
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
  *	@files: number of struct file referring this pipe (protected by ->i_lock)
@@ -43,6 +45,7 @@ struct pipe_buffer {
  *	@fasync_writers: writer side fasync
  *	@bufs: the circular array of pipe buffers
  *	@user: the user who created this pipe
+ *	@notifier: completion notifier for vmsplice(SPLICE_F_NOTIFY)
  **/
 struct pipe_inode_info {
 	struct mutex mutex;
@@ -54,11 +57,14 @@ struct pipe_inode_info {
 	unsigned int waiting_writers;
 	unsigned int r_counter;
 	unsigned int w_counter;
-	struct page *tmp_page;
+	unsigned int nr_tmp_pages;
+	struct page *tmp_pages[PIPE_DEF_BUFFERS];
+	struct list_head pool_list;
 	struct fasync_struct *fasync_readers;
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
 	struct user_struct *user;
+	struct splice_notifier *notifier;
 };
 
 /*
@@ -19,6 +19,8 @@
 				 /* from/to, of course */
 #define SPLICE_F_MORE	(0x04)	/* expect more data */
 #define SPLICE_F_GIFT	(0x08)	/* pages passed in are a gift */
+#define SPLICE_F_NOTIFY	(0x10)	/* vmsplice: signal the pipe's notifier */
+				/* once the pages may be reused */
 
 /*
  * Passed to the actors
@@ -84,6 +86,9 @@ extern void spd_release_page(struct splice_pipe_desc *, unsigned int);
 
 extern const struct pipe_buf_operations page_cache_pipe_buf_ops;
 
+extern long splice_set_notifier(struct pipe_inode_info *, int);
+extern void splice_put_notifier(struct splice_notifier *);
+
 extern long do_splice_from(struct pipe_inode_info *pipe, struct file *out,
 			   loff_t *ppos, size_t len, unsigned int flags);
 extern long do_splice_to(struct file *in, loff_t *ppos,
@@ -72,15 +72,20 @@ static inline bool busy_loop_timeout(unsigned long end_time)
 	return time_after(now, end_time);
 }
 
-/* when used in sock_poll() nonblock is known at compile time to be true
- * so the loop and end_time will be optimized out
+/*
+ * Busy poll the NAPI context @napi_id until @loop_end(@loop_end_arg)
+ * reports that the caller has something to do, @end_time passes or we
+ * need to reschedule.  With @nonblock it polls only once, and @end_time
+ * is ignored.  Returns the last value of @loop_end().
  */
-static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+static inline bool napi_busy_loop(unsigned int napi_id, bool nonblock,
+				  unsigned long end_time,
+				  bool (*loop_end)(void *), void *loop_end_arg)
 {
-	unsigned long end_time = !nonblock ? sk_busy_loop_end_time(sk) : 0;
 	const struct net_device_ops *ops;
 	struct napi_struct *napi;
-	int rc = false;
+	bool done = false;
+	int rc;
 
 	/*
 	 * rcu read lock for napi hash
@@ -88,7 +93,7 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 	 */
 	rcu_read_lock_bh();
 
-	napi = napi_by_id(sk->sk_napi_id);
+	napi = napi_by_id(napi_id);
 	if (!napi)
 		goto out;
 
@@ -99,22 +104,42 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 	do {
 		rc = ops->ndo_busy_poll(napi);
 
-		if (rc == LL_FLUSH_FAILED)
-			break; /* permanent failure */
+		if (rc == LL_FLUSH_FAILED) {
+			/* permanent failure, but something may have queued */
+			done = loop_end(loop_end_arg);
+			break;
+		}
 
 		if (rc > 0)
 			/* local bh are disabled so it is ok to use _BH */
-			NET_ADD_STATS_BH(sock_net(sk),
+			NET_ADD_STATS_BH(dev_net(napi->dev),
 					 LINUX_MIB_BUSYPOLLRXPACKETS, rc);
-		cpu_relax();
 
-	} while (!nonblock && skb_queue_empty(&sk->sk_receive_queue) &&
-		 !need_resched() && !busy_loop_timeout(end_time));
+		done = loop_end(loop_end_arg);
+		if (done || nonblock)
+			break;
+		cpu_relax();
 
-	rc = !skb_queue_empty(&sk->sk_receive_queue);
+	} while (!need_resched() && !signal_pending(current) &&
+		 !busy_loop_timeout(end_time));
 out:
 	rcu_read_unlock_bh();
-	return rc;
+	return done;
+}
+
+static inline bool sk_busy_loop_end(void *p)
+{
+	struct sock *sk = p;
+
+	return !skb_queue_empty(&sk->sk_receive_queue);
+}
+
+static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	unsigned long end_time = !nonblock ? sk_busy_loop_end_time(sk) : 0;
+
+	return napi_busy_loop(sk->sk_napi_id, nonblock, end_time,
+			      sk_busy_loop_end, sk);
 }
 
 /* used in the NIC receive handler to mark the skb */
@@ -165,5 +190,12 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 	return false;
 }
 
+static inline bool napi_busy_loop(unsigned int napi_id, bool nonblock,
+				  unsigned long end_time,
+				  bool (*loop_end)(void *), void *loop_end_arg)
+{
+	return false;
+}
+
 #endif /* CONFIG_NET_RX_BUSY_POLL */
 #endif /* _LINUX_NET_BUSY_POLL_H */
@@ -709,9 +709,21 @@ __SYSCALL(__NR_memfd_create, sys_memfd_create)
 __SYSCALL(__NR_bpf, sys_bpf)
 #define __NR_execveat 281
 __SC_COMP(__NR_execveat, sys_execveat, compat_sys_execveat)
+#define __NR_epoll_ctl_batch 282
+__SYSCALL(__NR_epoll_ctl_batch, sys_epoll_ctl_batch)
+#define __NR_io_register 283
+__SYSCALL(__NR_io_register, sys_io_register)
+#define __NR_copy_file_range 284
+__SYSCALL(__NR_copy_file_range, sys_copy_file_range)
+#define __NR_readdirplus 285
+__SYSCALL(__NR_readdirplus, sys_readdirplus)
+#define __NR_pollset_create 286
+__SYSCALL(__NR_pollset_create, sys_pollset_create)
+#define __NR_pollset_poll 287
+__SYSCALL(__NR_pollset_poll, sys_pollset_poll)
 
 #undef __NR_syscalls
-#define __NR_syscalls 282
+#define __NR_syscalls 288
 
 /*
  * All syscalls below here should go away really,
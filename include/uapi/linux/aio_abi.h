@@ -37,10 +37,10 @@ enum {
 	IOCB_CMD_PWRITE = 1,
 	IOCB_CMD_FSYNC = 2,
 	IOCB_CMD_FDSYNC = 3,
-	/* These two are experimental.
+	/* This one is experimental.
 	 * IOCB_CMD_PREADX = 4,
-	 * IOCB_CMD_POLL = 5,
 	 */
+	IOCB_CMD_POLL = 5,
 	IOCB_CMD_NOOP = 6,
 	IOCB_CMD_PREADV = 7,
 	IOCB_CMD_PWRITEV = 8,
@@ -50,9 +50,17 @@ enum {
  * Valid flags for the "aio_flags" member of the "struct iocb".
  *
  * IOCB_FLAG_RESFD - Set if the "aio_resfd" member of the "struct iocb"
- *                   is valid.
+ *                   is valid. Refused for iocbs that the
+ *                   AIO_SQRING_POLL thread submits.
+ * IOCB_FLAG_FIXEDBUF - "aio_buf" points inside the buffer registered with
+ *                      AIO_REGISTER_BUFFERS whose index is in
+ *                      "aio_reserved2". IOCB_CMD_PREAD/PWRITE only.
+ * IOCB_FLAG_FIXEDFILE - "aio_fildes" is an index into the files registered
+ *                       with AIO_REGISTER_FILES.
  */
 #define IOCB_FLAG_RESFD		(1 << 0)
+#define IOCB_FLAG_FIXEDBUF	(1 << 1)
+#define IOCB_FLAG_FIXEDFILE	(1 << 2)
 
 /* read() from /dev/aio returns these structures. */
 struct io_event {
@@ -104,6 +112,39 @@ struct iocb {
 	__u32	aio_resfd;
 }; /* 64 bytes */
 
+/* io_register() opcodes */
+#define AIO_REGISTER_SQRING	0	/* arg: struct aio_sqring_setup */
+#define AIO_REGISTER_BUFFERS	1	/* arg: struct iovec[nr_args] */
+#define AIO_REGISTER_FILES	2	/* arg: __s32[nr_args] */
+
+/* aio_sqring_setup.flags */
+#define AIO_SQRING_POLL		(1 << 0)	/* a kernel thread polls the ring */
+
+struct aio_sqring_setup {
+	__u64	ring;		/* address of the struct aio_sqring */
+	__u32	entries;	/* number of iocbs, a power of two */
+	__u32	flags;
+	__u32	idle_ms;	/* AIO_SQRING_POLL: idle time before sleeping */
+	__u32	resv[3];
+};
+
+/* aio_sqring.flags, set by the kernel */
+#define AIO_SQRING_NEED_WAKEUP	(1 << 0)	/* kick with io_submit(ctx, 0) */
+
+/*
+ * Submission ring: userspace fills iocbs[tail & (entries - 1)] and then
+ * advances tail, the kernel consumes entries up to tail on
+ * io_submit(ctx, 0, NULL) or from its polling thread and advances head.
+ * Completions are reported through the regular event ring.
+ */
+struct aio_sqring {
+	__u32		head;
+	__u32		tail;
+	__u32		flags;
+	__u32		resv;
+	struct iocb	iocbs[0];
+};
+
 #undef IFBIG
 #undef IFLITTLE
 
@@ -26,6 +26,16 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/*
+ * Rotate exclusive wakeups among the epoll instances attached to the same
+ * wakeup source, so that events are spread across them.  Only valid
+ * together with EPOLLEXCLUSIVE.
+ */
+#define EPOLLROUNDROBIN (1 << 27)
+
+/* Set exclusive wakeup mode for the target file descriptor */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /*
  * Request the handling of system wakeup events so as to prevent system suspends
  * from happening while those events are being processed.
@@ -61,6 +71,23 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/* One operation of an epoll_ctl_batch() call */
+struct epoll_ctl_cmd {
+	/* Reserved for future extensions, must be 0 */
+	__u32 flags;
+	/* Same as the epoll_ctl() op argument */
+	__s32 op;
+	/* Same as the epoll_ctl() fd argument */
+	__s32 fd;
+	/* Same as the "events" field of struct epoll_event */
+	__u32 events;
+	/* Same as the "data" field of struct epoll_event */
+	__u64 data;
+	/* Set by the kernel to the epoll_ctl() return value of this command */
+	__s32 result;
+	__u32 __pad;
+};
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
@@ -33,6 +33,12 @@
 #define F_ADD_SEALS	(F_LINUX_SPECIFIC_BASE + 9)
 #define F_GET_SEALS	(F_LINUX_SPECIFIC_BASE + 10)
 
+/*
+ * Attach an eventfd to a pipe, signalled as vmsplice(SPLICE_F_NOTIFY)
+ * calls on it complete.  Pass -1 to detach.
+ */
+#define F_SETPIPE_NOTIFY	(F_LINUX_SPECIFIC_BASE + 11)
+
 /*
  * Types of seals
  */
@@ -0,0 +1,66 @@
+#ifndef _UAPI_LINUX_READDIRPLUS_H
+#define _UAPI_LINUX_READDIRPLUS_H
+
+#include <linux/types.h>
+
+/*
+ * Attributes which readdirplus() can return with each entry.  The mask
+ * passed to the system call selects which ones are wanted; the d_mask of
+ * every returned entry tells which ones were actually filled in.
+ */
+#define RDP_MODE	0x00000001U	/* st_mode */
+#define RDP_NLINK	0x00000002U	/* st_nlink */
+#define RDP_UID		0x00000004U	/* st_uid */
+#define RDP_GID		0x00000008U	/* st_gid */
+#define RDP_DEV		0x00000010U	/* st_dev */
+#define RDP_RDEV	0x00000020U	/* st_rdev */
+#define RDP_INO		0x00000040U	/* st_ino */
+#define RDP_SIZE	0x00000080U	/* st_size */
+#define RDP_BLOCKS	0x00000100U	/* st_blocks and st_blksize */
+#define RDP_ATIME	0x00000200U	/* st_atim */
+#define RDP_MTIME	0x00000400U	/* st_mtim */
+#define RDP_CTIME	0x00000800U	/* st_ctim */
+#define RDP_ALL		0x00000fffU
+
+struct rdp_timestamp {
+	__s64	tv_sec;
+	__u32	tv_nsec;
+	__u32	__reserved;
+};
+
+struct rdp_stat {
+	__u32	st_mode;
+	__u32	st_nlink;
+	__u32	st_uid;
+	__u32	st_gid;
+	__u32	st_dev;		/* new_encode_dev() format, as in stat64 */
+	__u32	st_rdev;
+	__u32	st_blksize;
+	__u32	__reserved;
+	__u64	st_ino;
+	__u64	st_size;
+	__u64	st_blocks;
+	struct rdp_timestamp st_atim;
+	struct rdp_timestamp st_mtim;
+	struct rdp_timestamp st_ctim;
+};
+
+/*
+ * One record in the readdirplus() buffer.  d_ino, d_off, d_reclen,
+ * d_type and d_name mean the same as for getdents64().  The d_stat block
+ * is only present when attributes were asked for (a non-zero mask), in
+ * which case the name follows it; use d_name_off to find the name.
+ */
+struct linux_dirent_plus {
+	__u64	d_ino;
+	__s64	d_off;
+	__u16	d_reclen;
+	__u16	d_name_off;	/* offset of the name from the record start */
+	__u8	d_type;
+	__u8	__reserved[3];
+	__u32	d_mask;		/* RDP_* attributes present in d_stat */
+	__s32	d_error;	/* or why they are not, as a negative errno */
+	/* struct rdp_stat d_stat, if requested; then the name */
+};
+
+#endif /* _UAPI_LINUX_READDIRPLUS_H */
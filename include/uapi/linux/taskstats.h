@@ -33,7 +33,7 @@
  */
 
 
-#define TASKSTATS_VERSION	8
+#define TASKSTATS_VERSION	9
 #define TS_COMM_LEN		32	/* should be >= TASK_COMM_LEN
 					 * in linux/sched.h */
 
@@ -163,6 +163,13 @@ struct taskstats {
 	/* Delay waiting for memory reclaim */
 	__u64	freepages_count;
 	__u64	freepages_delay_total;
+	/* version 8 ends here */
+
+	/* Thread group of the task, and its current memory usage */
+	__u32	ac_tgid;		/* Thread group ID */
+	__u32	ac_nr_threads;		/* Threads in the thread group */
+	__u64	cur_rss;		/* Current RSS usage, in KB */
+	__u64	cur_vm;			/* Current virtual memory size, in KB */
 };
 
 
@@ -170,6 +177,9 @@ struct taskstats {
  * Commands sent from userspace
  * Not versioned. New commands should only be inserted at the enum's end
  * prior to __TASKSTATS_CMD_MAX
+ *
+ * TASKSTATS_CMD_GET sent with NLM_F_DUMP returns the per-pid stats of every
+ * task in the caller's pid namespace, one TASKSTATS_CMD_NEW message each.
  */
 
 enum {
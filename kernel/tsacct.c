@@ -58,6 +58,8 @@ void bacct_add_tsk(struct user_namespace *user_ns,
 	stats->ac_nice	 = task_nice(tsk);
 	stats->ac_sched	 = tsk->policy;
 	stats->ac_pid	 = task_pid_nr_ns(tsk, pid_ns);
+	stats->ac_tgid	 = task_tgid_nr_ns(tsk, pid_ns);
+	stats->ac_nr_threads = get_nr_threads(tsk);
 	rcu_read_lock();
 	tcred = __task_cred(tsk);
 	stats->ac_uid	 = from_kuid_munged(user_ns, tcred->uid);
@@ -101,6 +103,8 @@ void xacct_add_tsk(struct taskstats *stats, struct task_struct *p)
 		/* adjust to KB unit */
 		stats->hiwater_rss   = get_mm_hiwater_rss(mm) * PAGE_SIZE / KB;
 		stats->hiwater_vm    = get_mm_hiwater_vm(mm)  * PAGE_SIZE / KB;
+		stats->cur_rss	     = get_mm_rss(mm) * PAGE_SIZE / KB;
+		stats->cur_vm	     = mm->total_vm * PAGE_SIZE / KB;
 		mmput(mm);
 	}
 	stats->read_char	= p->ioac.rchar & KB_MASK;
@@ -220,11 +220,29 @@ static ssize_t stable_pages_required_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(stable_pages_required);
 
+#define BDI_RA_STAT_SHOW(name, item)					\
+static ssize_t name##_show(struct device *dev,				\
+			   struct device_attribute *attr, char *page)	\
+{									\
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);		\
+									\
+	return snprintf(page, PAGE_SIZE-1, "%lld\n",			\
+			(long long)bdi_ra_stat_sum(bdi, item));		\
+}									\
+static DEVICE_ATTR_RO(name);
+
+BDI_RA_STAT_SHOW(read_ahead_pages, BDI_RA_READ)
+BDI_RA_STAT_SHOW(read_ahead_used, BDI_RA_USED)
+BDI_RA_STAT_SHOW(read_ahead_wasted, BDI_RA_WASTED)
+
 static struct attribute *bdi_dev_attrs[] = {
 	&dev_attr_read_ahead_kb.attr,
 	&dev_attr_min_ratio.attr,
 	&dev_attr_max_ratio.attr,
 	&dev_attr_stable_pages_required.attr,
+	&dev_attr_read_ahead_pages.attr,
+	&dev_attr_read_ahead_used.attr,
+	&dev_attr_read_ahead_wasted.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(bdi_dev);
@@ -764,6 +782,8 @@ static void cgwb_bdi_destroy(struct backing_dev_info *bdi) { }
 
 int bdi_init(struct backing_dev_info *bdi)
 {
+	int i, err;
+
 	bdi->dev = NULL;
 
 	bdi->min_ratio = 0;
@@ -772,7 +792,20 @@ int bdi_init(struct backing_dev_info *bdi)
 	INIT_LIST_HEAD(&bdi->bdi_list);
 	init_waitqueue_head(&bdi->wb_waitq);
 
-	return cgwb_bdi_init(bdi);
+	for (i = 0; i < NR_BDI_RA_STAT_ITEMS; i++) {
+		err = percpu_counter_init(&bdi->ra_stat[i], 0, GFP_KERNEL);
+		if (err)
+			goto out_destroy_stat;
+	}
+
+	err = cgwb_bdi_init(bdi);
+	if (!err)
+		return 0;
+
+out_destroy_stat:
+	while (i--)
+		percpu_counter_destroy(&bdi->ra_stat[i]);
+	return err;
 }
 EXPORT_SYMBOL(bdi_init);
 
@@ -839,8 +872,13 @@ void bdi_unregister(struct backing_dev_info *bdi)
 
 void bdi_exit(struct backing_dev_info *bdi)
 {
+	int i;
+
 	WARN_ON_ONCE(bdi->dev);
 	wb_exit(&bdi->wb);
+
+	for (i = 0; i < NR_BDI_RA_STAT_ITEMS; i++)
+		percpu_counter_destroy(&bdi->ra_stat[i]);
 }
 
 void bdi_destroy(struct backing_dev_info *bdi)
@@ -196,6 +196,10 @@ void __delete_from_page_cache(struct page *page, void *shadow,
 
 	page_cache_tree_delete(mapping, page, shadow);
 
+	/* Read ahead, but nobody got to use it */
+	if (PagePrefetched(page) && TestClearPagePrefetched(page))
+		bdi_ra_stat_add(inode_to_bdi(mapping->host), BDI_RA_WASTED, 1);
+
 	page->mapping = NULL;
 	/* Leave page->index set: truncation lookup relies upon it */
 
@@ -251,6 +255,47 @@ void delete_from_page_cache(struct page *page)
 }
 EXPORT_SYMBOL(delete_from_page_cache);
 
+/**
+ * delete_from_page_cache_batch - delete several pages from page cache
+ * @mapping: the address_space the pages belong to
+ * @pvec: the pages
+ *
+ * Like delete_from_page_cache() on every page in @pvec, but the pages are
+ * removed under a single hold of the tree_lock, as long as they are
+ * charged to the same memcg.  The pages must be locked and in @mapping.
+ * The page cache's references are dropped, the pagevec's are left to the
+ * caller.
+ */
+void delete_from_page_cache_batch(struct address_space *mapping,
+				  struct pagevec *pvec)
+{
+	void (*freepage)(struct page *) = mapping->a_ops->freepage;
+	struct mem_cgroup *memcg;
+	unsigned long flags;
+	int i = 0;
+
+	while (i < pagevec_count(pvec)) {
+		memcg = mem_cgroup_begin_page_stat(pvec->pages[i]);
+		spin_lock_irqsave(&mapping->tree_lock, flags);
+		do {
+			struct page *page = pvec->pages[i];
+
+			BUG_ON(!PageLocked(page));
+			BUG_ON(page->mapping != mapping);
+			__delete_from_page_cache(page, NULL, memcg);
+		} while (++i < pagevec_count(pvec) &&
+			 page_memcg(pvec->pages[i]) == memcg);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		mem_cgroup_end_page_stat(memcg);
+	}
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		if (freepage)
+			freepage(pvec->pages[i]);
+		page_cache_release(pvec->pages[i]);
+	}
+}
+
 static int filemap_check_errors(struct address_space *mapping)
 {
 	int ret = 0;
@@ -521,17 +566,11 @@ int replace_page_cache_page(struct page *old, struct page *new, gfp_t gfp_mask)
 }
 EXPORT_SYMBOL_GPL(replace_page_cache_page);
 
-static int page_cache_tree_insert(struct address_space *mapping,
+/* Store @page in @slot of @node, which was returned by __radix_tree_create() */
+static int page_cache_slot_insert(struct address_space *mapping,
+				  struct radix_tree_node *node, void **slot,
 				  struct page *page, void **shadowp)
 {
-	struct radix_tree_node *node;
-	void **slot;
-	int error;
-
-	error = __radix_tree_create(&mapping->page_tree, page->index,
-				    &node, &slot);
-	if (error)
-		return error;
 	if (*slot) {
 		void *p;
 
@@ -563,6 +602,20 @@ static int page_cache_tree_insert(struct address_space *mapping,
 	return 0;
 }
 
+static int page_cache_tree_insert(struct address_space *mapping,
+				  struct page *page, void **shadowp)
+{
+	struct radix_tree_node *node;
+	void **slot;
+	int error;
+
+	error = __radix_tree_create(&mapping->page_tree, page->index,
+				    &node, &slot);
+	if (error)
+		return error;
+	return page_cache_slot_insert(mapping, node, slot, page, shadowp);
+}
+
 static int __add_to_page_cache_locked(struct page *page,
 				      struct address_space *mapping,
 				      pgoff_t offset, gfp_t gfp_mask,
@@ -663,6 +716,166 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/*
+ * Add up to PAGEVEC_SIZE pages at consecutive indices, which all fall into
+ * one radix tree node, with one descent into the tree under one hold of
+ * the tree_lock.  Returns how many pages from the start of @pages were
+ * added; the others are left alone.
+ */
+static unsigned add_to_page_cache_lru_node(struct page **pages, unsigned nr,
+					   struct address_space *mapping,
+					   pgoff_t offset, gfp_t gfp_mask)
+{
+	struct mem_cgroup *memcg[PAGEVEC_SIZE];
+	void *shadow[PAGEVEC_SIZE];
+	struct radix_tree_node *node;
+	unsigned i, charged, added = 0;
+	void **slot;
+
+	for (charged = 0; charged < nr; charged++) {
+		VM_BUG_ON_PAGE(PageSwapBacked(pages[charged]), pages[charged]);
+		if (mem_cgroup_try_charge(pages[charged], current->mm,
+					  gfp_mask, &memcg[charged]))
+			break;
+	}
+	if (!charged)
+		return 0;
+
+	if (radix_tree_maybe_preload(gfp_mask & ~__GFP_HIGHMEM))
+		goto out;
+
+	for (i = 0; i < charged; i++) {
+		__set_page_locked(pages[i]);
+		page_cache_get(pages[i]);
+		pages[i]->mapping = mapping;
+		pages[i]->index = offset + i;
+		shadow[i] = NULL;
+	}
+
+	spin_lock_irq(&mapping->tree_lock);
+	/* Creating the last slot makes the tree high enough for all */
+	if (!__radix_tree_create(&mapping->page_tree, offset + charged - 1,
+				 &node, &slot)) {
+		/* Without a node, the only slot is the root's at index 0 */
+		slot -= charged - 1;
+		for (added = 0; added < charged; added++) {
+			if (page_cache_slot_insert(mapping, node, slot + added,
+						   pages[added],
+						   &shadow[added]))
+				break;
+			__inc_zone_page_state(pages[added], NR_FILE_PAGES);
+		}
+	}
+	radix_tree_preload_end();
+	spin_unlock_irq(&mapping->tree_lock);
+
+	for (i = added; i < charged; i++) {
+		pages[i]->mapping = NULL;
+		/* Leave page->index set: truncation relies upon it */
+		page_cache_release(pages[i]);
+		__clear_page_locked(pages[i]);
+	}
+
+	for (i = 0; i < added; i++) {
+		struct page *page = pages[i];
+
+		mem_cgroup_commit_charge(page, memcg[i], false);
+		trace_mm_filemap_add_to_page_cache(page);
+		if (shadow[i] && workingset_refault(shadow[i])) {
+			SetPageActive(page);
+			workingset_activation(page);
+		} else
+			ClearPageActive(page);
+		lru_cache_add(page);
+	}
+out:
+	for (i = added; i < charged; i++)
+		mem_cgroup_cancel_charge(pages[i], memcg[i]);
+	return added;
+}
+
+/**
+ * add_to_page_cache_lru_batch - add a run of pages to the pagecache
+ * @pages:	the pages to add
+ * @nr_pages:	number of pages
+ * @mapping:	the pages' address_space
+ * @offset:	index of the first page, the others follow it
+ * @gfp_mask:	page allocation mode
+ *
+ * Like add_to_page_cache_lru() on every page, but the pages which share a
+ * radix tree node are added with a single descent into the tree and under
+ * a single hold of the tree_lock, PAGEVEC_SIZE at a time.  Returns the
+ * number of pages added, from the start of @pages; it stops at the first
+ * page which cannot be added, e.g. because its index was populated
+ * meanwhile.  The pages added are locked and on the LRU, and the caller
+ * keeps its reference to each page.
+ */
+unsigned add_to_page_cache_lru_batch(struct page **pages, unsigned nr_pages,
+				     struct address_space *mapping,
+				     pgoff_t offset, gfp_t gfp_mask)
+{
+	unsigned added = 0;
+
+	while (added < nr_pages) {
+		unsigned nr, ret;
+
+		nr = RADIX_TREE_MAP_SIZE -
+			((offset + added) & RADIX_TREE_MAP_MASK);
+		nr = min3(nr, nr_pages - added, (unsigned)PAGEVEC_SIZE);
+		ret = add_to_page_cache_lru_node(pages + added, nr, mapping,
+						 offset + added, gfp_mask);
+		added += ret;
+		if (ret < nr)
+			break;
+	}
+	return added;
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_batch);
+
+/**
+ * add_to_page_cache_lru_list - add pages from a readahead list to the pagecache
+ * @pages:	list of pages with ->index set, as passed to ->readpages()
+ * @batch:	array which receives the pages
+ * @nr:		number of pages to take off @pages
+ * @mapping:	the pages' address_space
+ * @gfp_mask:	page allocation mode
+ *
+ * Takes @nr pages off the tail of @pages into @batch and adds them to the
+ * pagecache with add_to_page_cache_lru_batch(), a run of consecutive
+ * indices at a time.  A page which cannot be added is released and its
+ * entry in @batch set to NULL, as ->readpages() implementations do when
+ * add_to_page_cache_lru() fails.  Returns the number of entries in @batch.
+ */
+unsigned add_to_page_cache_lru_list(struct list_head *pages,
+				    struct page **batch, unsigned nr,
+				    struct address_space *mapping,
+				    gfp_t gfp_mask)
+{
+	unsigned i, run, added;
+
+	for (i = 0; i < nr && !list_empty(pages); i++) {
+		batch[i] = list_entry(pages->prev, struct page, lru);
+		list_del(&batch[i]->lru);
+	}
+	nr = i;
+
+	for (i = 0; i < nr; i += run) {
+		for (run = 1; i + run < nr; run++)
+			if (batch[i + run]->index != batch[i]->index + run)
+				break;
+		added = add_to_page_cache_lru_batch(batch + i, run, mapping,
+						    batch[i]->index, gfp_mask);
+		if (added < run) {
+			/* Skip the page which failed, retry the rest */
+			page_cache_release(batch[i + added]);
+			batch[i + added] = NULL;
+			run = added + 1;
+		}
+	}
+	return nr;
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_list);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -1520,6 +1733,7 @@ find_page:
 			if (unlikely(page == NULL))
 				goto no_cached_page;
 		}
+		page_cache_ra_used(mapping, page);
 		if (PageReadahead(page)) {
 			page_cache_async_readahead(mapping,
 					ra, filp, page,
@@ -1840,6 +2054,7 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
 	ra->async_size = ra_pages / 4;
+	ra->misses = 0;
 	ra_submit(ra, mapping, file);
 }
 
@@ -1927,6 +2142,8 @@ retry_find:
 			goto no_cached_page;
 	}
 
+	page_cache_ra_used(mapping, page);
+
 	if (!lock_page_or_retry(page, vma->vm_mm, vmf->flags)) {
 		page_cache_release(page);
 		return ret | VM_FAULT_RETRY;
@@ -2066,6 +2283,7 @@ repeat:
 
 		if (file->f_ra.mmap_miss > 0)
 			file->f_ra.mmap_miss--;
+		page_cache_ra_used(mapping, page);
 		addr = address + (page->index - vmf->pgoff) * PAGE_SIZE;
 		do_set_pte(vma, addr, page, pte, false, false);
 		unlock_page(page);
@@ -187,7 +187,12 @@ struct page *follow_page_mask(struct vm_area_struct *vma,
 	if ((flags & FOLL_NUMA) && pmd_protnone(*pmd))
 		return no_page_table(vma, flags);
 	if (pmd_trans_huge(*pmd)) {
-		if (flags & FOLL_SPLIT) {
+		/*
+		 * mlock works on ptes: zap a page cache extent for it and
+		 * let the VM_LOCKED vma fault the range back in with ptes.
+		 */
+		if ((flags & FOLL_SPLIT) || (huge_pmd_maps_pagecache(vma) &&
+					     (vma->vm_flags & VM_LOCKED))) {
 			split_huge_page_pmd(vma, address, pmd);
 			return follow_page_pte(vma, address, pmd, flags);
 		}
@@ -851,6 +851,10 @@ int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	pgtable_t pgtable;
 	int ret;
 
+	/* The child faults page cache extents in again */
+	if (huge_pmd_maps_pagecache(vma))
+		return 0;
+
 	ret = -ENOMEM;
 	pgtable = pte_alloc_one(dst_mm, addr);
 	if (unlikely(!pgtable))
@@ -1092,7 +1096,7 @@ int do_huge_pmd_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	gfp_t huge_gfp;			/* for allocation and charge */
 
 	ptl = pmd_lockptr(mm, pmd);
-	VM_BUG_ON_VMA(!vma->anon_vma, vma);
+	VM_BUG_ON_VMA(!vma->anon_vma && !huge_pmd_maps_pagecache(vma), vma);
 	haddr = address & HPAGE_PMD_MASK;
 	if (is_huge_zero_pmd(orig_pmd))
 		goto alloc;
@@ -1101,8 +1105,10 @@ int do_huge_pmd_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out_unlock;
 
 	page = pmd_page(orig_pmd);
-	VM_BUG_ON_PAGE(!PageCompound(page) || !PageHead(page), page);
-	if (page_mapcount(page) == 1) {
+	VM_BUG_ON_PAGE(!huge_pmd_maps_pagecache(vma) &&
+		       (!PageCompound(page) || !PageHead(page)), page);
+	/* Page cache extents are only mapped shared: write them in place */
+	if (huge_pmd_maps_pagecache(vma) || page_mapcount(page) == 1) {
 		pmd_t entry;
 		entry = pmd_mkyoung(orig_pmd);
 		entry = maybe_pmd_mkwrite(pmd_mkdirty(entry), vma);
@@ -1222,7 +1228,7 @@ struct page *follow_trans_huge_pmd(struct vm_area_struct *vma,
 		goto out;
 
 	page = pmd_page(*pmd);
-	VM_BUG_ON_PAGE(!PageHead(page), page);
+	VM_BUG_ON_PAGE(!huge_pmd_maps_pagecache(vma) && !PageHead(page), page);
 	if (flags & FOLL_TOUCH) {
 		pmd_t _pmd;
 		/*
@@ -1247,7 +1253,8 @@ struct page *follow_trans_huge_pmd(struct vm_area_struct *vma,
 		}
 	}
 	page += (addr & ~HPAGE_PMD_MASK) >> PAGE_SHIFT;
-	VM_BUG_ON_PAGE(!PageCompound(page), page);
+	VM_BUG_ON_PAGE(!huge_pmd_maps_pagecache(vma) && !PageCompound(page),
+		       page);
 	if (flags & FOLL_GET)
 		get_page_foll(page);
 
@@ -1384,6 +1391,30 @@ out:
 	return 0;
 }
 
+/*
+ * Drop the mappings of the page cache extent that @orig_pmd mapped, passing
+ * the dirty and accessed bits on to its pages like zap_pte_range() does.
+ * Returns the first page of the extent; the caller still holds a reference
+ * to each of its pages.
+ */
+static struct page *zap_huge_pmd_pagecache(struct vm_area_struct *vma,
+					   pmd_t orig_pmd)
+{
+	struct page *page = pmd_page(orig_pmd);
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (pmd_dirty(orig_pmd))
+			set_page_dirty(page + i);
+		if (pmd_young(orig_pmd) &&
+		    likely(!(vma->vm_flags & VM_SEQ_READ)))
+			mark_page_accessed(page + i);
+		page_remove_rmap(page + i);
+	}
+	add_mm_counter(vma->vm_mm, MM_FILEPAGES, -HPAGE_PMD_NR);
+	return page;
+}
+
 int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		 pmd_t *pmd, unsigned long addr)
 {
@@ -1394,6 +1425,7 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		struct page *page;
 		pgtable_t pgtable;
 		pmd_t orig_pmd;
+		int i;
 		/*
 		 * For architectures like ppc64 we look at deposited pgtable
 		 * when calling pmdp_huge_get_and_clear. So do the
@@ -1403,6 +1435,14 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		orig_pmd = pmdp_huge_get_and_clear_full(tlb->mm, addr, pmd,
 							tlb->fullmm);
 		tlb_remove_pmd_tlb_entry(tlb, pmd, addr);
+		if (huge_pmd_maps_pagecache(vma)) {
+			/* ->pmd_fault() deposits no page table */
+			page = zap_huge_pmd_pagecache(vma, orig_pmd);
+			spin_unlock(ptl);
+			for (i = 0; i < HPAGE_PMD_NR; i++)
+				tlb_remove_page(tlb, page + i);
+			return 1;
+		}
 		pgtable = pgtable_trans_huge_withdraw(tlb->mm, pmd);
 		if (is_huge_zero_pmd(orig_pmd)) {
 			atomic_long_dec(&tlb->mm->nr_ptes);
@@ -1504,6 +1544,12 @@ int change_huge_pmd(struct vm_area_struct *vma, pmd_t *pmd,
 			return ret;
 		}
 
+		/* Page cache extents are not migrated on hinting faults */
+		if (prot_numa && huge_pmd_maps_pagecache(vma)) {
+			spin_unlock(ptl);
+			return ret;
+		}
+
 		if (!prot_numa || !pmd_protnone(*pmd)) {
 			entry = pmdp_huge_get_and_clear_notify(mm, addr, pmd);
 			entry = pmd_modify(entry, newprot);
@@ -1511,7 +1557,8 @@ int change_huge_pmd(struct vm_area_struct *vma, pmd_t *pmd,
 				entry = pmd_mkwrite(entry);
 			ret = HPAGE_PMD_NR;
 			set_pmd_at(mm, addr, pmd, entry);
-			BUG_ON(!preserve_write && pmd_write(entry));
+			BUG_ON(!preserve_write && pmd_write(entry) &&
+			       !huge_pmd_maps_pagecache(vma));
 		}
 		spin_unlock(ptl);
 	}
@@ -1922,6 +1969,12 @@ out:
 int hugepage_madvise(struct vm_area_struct *vma,
 		     unsigned long *vm_flags, int advice)
 {
+	unsigned long no_thp = VM_NO_THP;
+
+	/* ->pmd_fault() maps shared page cache with huge pmds */
+	if (vma->vm_ops && vma->vm_ops->pmd_fault)
+		no_thp &= ~(VM_SHARED | VM_MAYSHARE);
+
 	switch (advice) {
 	case MADV_HUGEPAGE:
 #ifdef CONFIG_S390
@@ -1936,7 +1989,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_HUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_HUGEPAGE | no_thp))
 			return -EINVAL;
 		*vm_flags &= ~VM_NOHUGEPAGE;
 		*vm_flags |= VM_HUGEPAGE;
@@ -1952,7 +2005,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_NOHUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_NOHUGEPAGE | no_thp))
 			return -EINVAL;
 		*vm_flags &= ~VM_HUGEPAGE;
 		*vm_flags |= VM_NOHUGEPAGE;
@@ -2905,6 +2958,22 @@ again:
 		mmu_notifier_invalidate_range_end(mm, mmun_start, mmun_end);
 		return;
 	}
+	if (huge_pmd_maps_pagecache(vma)) {
+		int i;
+
+		/*
+		 * Just zap a page cache extent: the pages stay in the page
+		 * cache, and the range faults back in with ptes or another
+		 * huge pmd as fits.
+		 */
+		page = zap_huge_pmd_pagecache(vma,
+				pmdp_huge_clear_flush_notify(vma, haddr, pmd));
+		spin_unlock(ptl);
+		mmu_notifier_invalidate_range_end(mm, mmun_start, mmun_end);
+		for (i = 0; i < HPAGE_PMD_NR; i++)
+			put_page(page + i);
+		return;
+	}
 	page = pmd_page(*pmd);
 	VM_BUG_ON_PAGE(!page_count(page), page);
 	get_page(page);
@@ -16,6 +16,7 @@
 #include <linux/kmemleak.h>
 #include <linux/range.h>
 #include <linux/memblock.h>
+#include <linux/sched.h>
 
 #include <asm/bug.h>
 #include <asm/io.h>
@@ -186,6 +187,7 @@ void __init reset_all_zones_managed_pages(void)
  */
 unsigned long __init free_all_bootmem(void)
 {
+	u64 start = local_clock();
 	unsigned long pages;
 
 	reset_all_zones_managed_pages();
@@ -198,6 +200,9 @@ unsigned long __init free_all_bootmem(void)
 	pages = free_low_memory_core_early();
 	totalram_pages += pages;
 
+	pr_info("Freed %lu early pages to the buddy allocator in %llums\n",
+		pages, div_u64(local_clock() - start, NSEC_PER_MSEC));
+
 	return pages;
 }
 
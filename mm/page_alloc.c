@@ -281,11 +281,25 @@ static inline bool update_defer_init(pg_data_t *pgdat,
 
 	return true;
 }
+
+static void __init report_deferred_meminit(pg_data_t *pgdat)
+{
+	if (pgdat->first_deferred_pfn == ULONG_MAX)
+		return;
+
+	pr_info("  node %3d: deferring memmap from [mem %#018Lx-%#018Lx]\n",
+		pgdat->node_id, (u64)pgdat->first_deferred_pfn << PAGE_SHIFT,
+		((u64)pgdat_end_pfn(pgdat) << PAGE_SHIFT) - 1);
+}
 #else
 static inline void reset_deferred_meminit(pg_data_t *pgdat)
 {
 }
 
+static inline void report_deferred_meminit(pg_data_t *pgdat)
+{
+}
+
 static inline bool early_page_uninitialised(unsigned long pfn)
 {
 	return false;
@@ -1211,6 +1225,7 @@ free_range:
 
 void __init page_alloc_init_late(void)
 {
+	unsigned long start = jiffies;
 	int nid;
 
 	/* There will be num_node_state(N_MEMORY) threads */
@@ -1221,6 +1236,8 @@ void __init page_alloc_init_late(void)
 
 	/* Block until all are initialised */
 	wait_for_completion(&pgdat_init_all_done_comp);
+	pr_info("Deferred memmap of %d nodes initialised in %ums\n",
+		num_node_state(N_MEMORY), jiffies_to_msecs(jiffies - start));
 
 	/* Reinit limits that are based on free pages after the kernel is up */
 	files_maxfiles_init();
@@ -3265,6 +3282,222 @@ out:
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+static inline void bulk_add_page(struct page *page, struct list_head *page_list,
+				 struct page **page_array, unsigned long *slot)
+{
+	if (page_list) {
+		list_add_tail(&page->lru, page_list);
+		return;
+	}
+	while (page_array[*slot])
+		(*slot)++;
+	page_array[(*slot)++] = page;
+}
+
+/*
+ * Find a zone which can spare @nr_pages pages without going below its
+ * watermark, applying the zone policies of get_page_from_freelist().
+ */
+static struct zone *bulk_find_zone(gfp_t gfp_mask, int alloc_flags,
+				   const struct alloc_context *ac,
+				   unsigned long nr_pages, int *nr_fair_skipped)
+{
+	struct zoneref *z;
+	struct zone *zone;
+
+	for_each_zone_zonelist_nodemask(zone, z, ac->zonelist, ac->high_zoneidx,
+								ac->nodemask) {
+		unsigned long mark;
+
+		if (cpusets_enabled() &&
+			(alloc_flags & ALLOC_CPUSET) &&
+			!cpuset_zone_allowed(zone, gfp_mask))
+				continue;
+		if (alloc_flags & ALLOC_FAIR) {
+			if (!zone_local(ac->preferred_zone, zone))
+				break;
+			if (test_bit(ZONE_FAIR_DEPLETED, &zone->flags)) {
+				(*nr_fair_skipped)++;
+				continue;
+			}
+		}
+		if ((gfp_mask & __GFP_WRITE) && !zone_dirty_ok(zone))
+			continue;
+
+		mark = zone->watermark[alloc_flags & ALLOC_WMARK_MASK];
+		if (zone_watermark_ok(zone, 0, mark + nr_pages,
+				      ac->classzone_idx, alloc_flags))
+			return zone;
+	}
+	return NULL;
+}
+
+/**
+ * __alloc_pages_bulk - allocate a number of order-0 pages to a list or array
+ * @gfp_mask: GFP flags for the allocation
+ * @zonelist: zonelist to allocate from
+ * @nodemask: set of nodes to allocate from, may be NULL
+ * @nr_pages: number of pages wanted
+ * @page_list: list to add the pages to, or NULL
+ * @page_array: array of @nr_pages entries to fill the NULL entries of, if
+ *              @page_list is NULL
+ *
+ * The pages are taken from the per-cpu list of the first zone which can
+ * spare them all without going below its low watermark, in one pass with
+ * interrupts disabled once, refilling the per-cpu list from the buddy
+ * lists under a single hold of zone->lock when it runs out.  The zone is
+ * picked as by the fast path of __alloc_pages_nodemask(): the fair zone
+ * allocation policy comes first, and a change of the cpuset's nodes while
+ * looking for a zone makes it look again.  If no zone can spare the
+ * pages, or nothing could be taken, this falls back to allocating a single
+ * page through the usual path, which may reclaim: the caller has to
+ * cope with fewer pages than it asked for.
+ *
+ * Returns the number of pages added to @page_list, or the number of
+ * populated entries in @page_array.
+ */
+unsigned long __alloc_pages_bulk(gfp_t gfp_mask, struct zonelist *zonelist,
+			nodemask_t *nodemask, unsigned long nr_pages,
+			struct list_head *page_list, struct page **page_array)
+{
+	struct zoneref *preferred_zoneref;
+	struct zone *zone;
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	struct page *page, *next;
+	unsigned long flags, i;
+	unsigned long nr_populated = 0, nr_wanted, nr_taken = 0, slot = 0;
+	bool cold = ((gfp_mask & __GFP_COLD) != 0);
+	unsigned int cpuset_mems_cookie;
+	int alloc_flags = ALLOC_WMARK_LOW|ALLOC_CPUSET|ALLOC_FAIR;
+	int nr_fair_skipped;
+	gfp_t alloc_mask;
+	struct alloc_context ac = {
+		.high_zoneidx = gfp_zone(gfp_mask),
+		.nodemask = nodemask,
+		.migratetype = gfpflags_to_migratetype(gfp_mask),
+	};
+	LIST_HEAD(taken);
+
+	if (page_array) {
+		for (i = 0; i < nr_pages; i++)
+			if (page_array[i])
+				nr_populated++;
+	}
+	nr_wanted = nr_pages - nr_populated;
+	if (!nr_wanted)
+		return nr_populated;
+
+	/* Not worth it for a single page */
+	if (nr_wanted == 1)
+		goto failed;
+
+	gfp_mask &= gfp_allowed_mask;
+	alloc_mask = gfp_mask|__GFP_HARDWALL;
+
+	lockdep_trace_alloc(gfp_mask);
+
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	if (should_fail_alloc_page(gfp_mask, 0))
+		goto failed;
+	if (unlikely(!zonelist->_zonerefs->zone))
+		goto failed;
+
+	if (IS_ENABLED(CONFIG_CMA) && ac.migratetype == MIGRATE_MOVABLE)
+		alloc_flags |= ALLOC_CMA;
+
+retry_cpuset:
+	cpuset_mems_cookie = read_mems_allowed_begin();
+
+	ac.zonelist = zonelist;
+	preferred_zoneref = first_zones_zonelist(ac.zonelist, ac.high_zoneidx,
+				ac.nodemask ? : &cpuset_current_mems_allowed,
+				&ac.preferred_zone);
+	if (!ac.preferred_zone)
+		goto failed_cpuset;
+	ac.classzone_idx = zonelist_zone_idx(preferred_zoneref);
+
+	/* Find a zone which can spare the whole batch */
+	nr_fair_skipped = 0;
+	zone = bulk_find_zone(alloc_mask, alloc_flags, &ac, nr_wanted,
+			      &nr_fair_skipped);
+	if (!zone && (nr_fair_skipped || nr_online_nodes > 1)) {
+		/* Without fairness and with remote zones, as the fast path does */
+		if (nr_fair_skipped)
+			reset_alloc_batches(ac.preferred_zone);
+		zone = bulk_find_zone(alloc_mask, alloc_flags & ~ALLOC_FAIR,
+				      &ac, nr_wanted, &nr_fair_skipped);
+	}
+	if (!zone)
+		goto failed_cpuset;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->lists[ac.migratetype];
+	while (nr_taken < nr_wanted) {
+		if (list_empty(list)) {
+			pcp->count += rmqueue_bulk(zone, 0,
+					max_t(unsigned long, pcp->batch,
+					      nr_wanted - nr_taken),
+					list, ac.migratetype, cold);
+			if (unlikely(list_empty(list)))
+				break;
+		}
+
+		if (cold)
+			page = list_entry(list->prev, struct page, lru);
+		else
+			page = list_entry(list->next, struct page, lru);
+
+		list_move_tail(&page->lru, &taken);
+		pcp->count--;
+		nr_taken++;
+		zone_statistics(ac.preferred_zone, zone, gfp_mask);
+	}
+
+	__mod_zone_page_state(zone, NR_ALLOC_BATCH, -nr_taken);
+	if (atomic_long_read(&zone->vm_stat[NR_ALLOC_BATCH]) <= 0 &&
+	    !test_bit(ZONE_FAIR_DEPLETED, &zone->flags))
+		set_bit(ZONE_FAIR_DEPLETED, &zone->flags);
+
+	__count_zone_vm_events(PGALLOC, zone, nr_taken);
+	local_irq_restore(flags);
+
+	if (!nr_taken)
+		goto failed_cpuset;
+
+	list_for_each_entry_safe(page, next, &taken, lru) {
+		list_del(&page->lru);
+		VM_BUG_ON_PAGE(bad_range(zone, page), page);
+		/* A bad page is left alone, as in get_page_from_freelist() */
+		if (prep_new_page(page, 0, gfp_mask, alloc_flags))
+			continue;
+		if (kmemcheck_enabled)
+			kmemcheck_pagealloc_alloc(page, 0, gfp_mask);
+		trace_mm_page_alloc(page, 0, alloc_mask, ac.migratetype);
+
+		bulk_add_page(page, page_list, page_array, &slot);
+		nr_populated++;
+	}
+
+	return nr_populated;
+
+failed_cpuset:
+	/* As in __alloc_pages_nodemask(), the cpuset may have changed */
+	if (unlikely(read_mems_allowed_retry(cpuset_mems_cookie)))
+		goto retry_cpuset;
+failed:
+	page = __alloc_pages_nodemask(gfp_mask, 0, zonelist, nodemask);
+	if (page) {
+		bulk_add_page(page, page_list, page_array, &slot);
+		nr_populated++;
+	}
+
+	return nr_populated;
+}
+EXPORT_SYMBOL(__alloc_pages_bulk);
+
 /*
  * Common helper functions.
  */
@@ -5812,6 +6045,7 @@ static void check_for_memory(pg_data_t *pgdat, int nid)
 void __init free_area_init_nodes(unsigned long *max_zone_pfn)
 {
 	unsigned long start_pfn, end_pfn;
+	u64 start;
 	int i, nid;
 
 	/* Record where the zone boundaries are */
@@ -5871,6 +6105,7 @@ void __init free_area_init_nodes(unsigned long *max_zone_pfn)
 	/* Initialise every node */
 	mminit_verify_pageflags_layout();
 	setup_nr_node_ids();
+	start = local_clock();
 	for_each_online_node(nid) {
 		pg_data_t *pgdat = NODE_DATA(nid);
 		free_area_init_node(nid, NULL,
@@ -5880,7 +6115,10 @@ void __init free_area_init_nodes(unsigned long *max_zone_pfn)
 		if (pgdat->node_present_pages)
 			node_set_state(nid, N_MEMORY);
 		check_for_memory(pgdat, nid);
+		report_deferred_meminit(pgdat);
 	}
+	pr_info("Early memmap initialised in %llums\n",
+		div_u64(local_clock() - start, NSEC_PER_MSEC));
 }
 
 static int __init cmdline_parse_core(char *p, unsigned long *core)
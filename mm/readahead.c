@@ -111,8 +111,9 @@ EXPORT_SYMBOL(read_cache_pages);
 static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
+	struct page *batch[PAGEVEC_SIZE];
 	struct blk_plug plug;
-	unsigned page_idx;
+	unsigned page_idx, i, nr;
 	int ret;
 
 	blk_start_plug(&plug);
@@ -124,14 +125,16 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = list_to_page(pages);
-		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
+	for (page_idx = 0; page_idx < nr_pages; page_idx += nr) {
+		nr = add_to_page_cache_lru_list(pages, batch,
+				min_t(unsigned, nr_pages - page_idx, PAGEVEC_SIZE),
+				mapping, GFP_KERNEL);
+		for (i = 0; i < nr; i++) {
+			if (!batch[i])
+				continue;
+			mapping->a_ops->readpage(filp, batch[i]);
+			page_cache_release(batch[i]);
 		}
-		page_cache_release(page);
 	}
 	ret = 0;
 
@@ -185,6 +188,7 @@ int __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (!page)
 			break;
 		page->index = page_offset;
+		__SetPagePrefetched(page);
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
@@ -196,8 +200,10 @@ int __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
+		bdi_ra_stat_add(inode_to_bdi(inode), BDI_RA_READ, ret);
 		read_pages(mapping, filp, &page_pool, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -280,6 +286,45 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
 	return min(newsize, max);
 }
 
+/*
+ * Size the window which follows the current one.  If some of the pages read
+ * ahead since the current one was set up were evicted before they could be
+ * used, memory is too tight for the window: halve it.  Otherwise ramp it up
+ * as usual.
+ *
+ * Only misses are fed back: they are seen by readahead itself, whereas hits
+ * depend on every reader of the page cache reporting them, and a reader
+ * which does not must not keep the window small.
+ */
+static unsigned long get_adaptive_ra_size(struct file_ra_state *ra,
+					  unsigned long max)
+{
+	if (ra->misses)
+		return max_t(unsigned long, ra->size / 2, 1);
+	return get_next_ra_size(ra, max);
+}
+
+/*
+ * Pages left in the window when the next one gets read ahead.  Normally the
+ * whole window, for maximum pipelining; when readahead pages are thrashing,
+ * trigger late, so that fewer of them wait in memory.
+ */
+static unsigned long get_async_ra_size(struct file_ra_state *ra)
+{
+	if (ra->misses)
+		return max_t(unsigned long, ra->size / 4, 1);
+	return ra->size;
+}
+
+/*
+ * A page read ahead for @mapping is used for the first time.
+ */
+void __page_cache_ra_used(struct address_space *mapping)
+{
+	bdi_ra_stat_add(inode_to_bdi(mapping->host), BDI_RA_USED, 1);
+}
+EXPORT_SYMBOL_GPL(__page_cache_ra_used);
+
 /*
  * On-demand readahead design.
  *
@@ -317,6 +362,13 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * misses counts the pages read ahead which got evicted before they could be
+ * used since the window was last set up.  It is fed back into the size of
+ * the next window and into its async_size, see get_adaptive_ra_size().
+ * Pages are only known to have been evicted when a sync read misses the
+ * current window, as a page no longer knows the file it was read ahead for
+ * once it is gone.
  */
 
 /*
@@ -383,6 +435,13 @@ ondemand_readahead(struct address_space *mapping,
 	unsigned long max = max_sane_readahead(ra->ra_pages);
 	pgoff_t prev_offset;
 
+	/*
+	 * A cache miss inside the current window: the pages read ahead from
+	 * here on have been evicted before they could be used.
+	 */
+	if (!hit_readahead_marker && ra_has_index(ra, offset))
+		ra->misses += ra->start + ra->size - offset;
+
 	/*
 	 * start of file
 	 */
@@ -396,8 +455,8 @@ ondemand_readahead(struct address_space *mapping,
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
 		ra->start += ra->size;
-		ra->size = get_next_ra_size(ra, max);
-		ra->async_size = ra->size;
+		ra->size = get_adaptive_ra_size(ra, max);
+		ra->async_size = get_async_ra_size(ra);
 		goto readit;
 	}
 
@@ -420,8 +479,8 @@ ondemand_readahead(struct address_space *mapping,
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
-		ra->size = get_next_ra_size(ra, max);
-		ra->async_size = ra->size;
+		ra->size = get_adaptive_ra_size(ra, max);
+		ra->async_size = get_async_ra_size(ra);
 		goto readit;
 	}
 
@@ -454,11 +513,16 @@ ondemand_readahead(struct address_space *mapping,
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	/* Do not restart a thrashing stream with a bigger window */
+	if (ra->misses)
+		max = min(max, max_t(unsigned long, ra->size / 2, req_size));
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
 
 readit:
+	ra->misses = 0;
+
 	/*
 	 * Will this read hit the readahead marker made by itself?
 	 * If so, trigger the readahead marker hit now, and merge
@@ -63,6 +63,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/namei.h>
 #include <linux/ctype.h>
 #include <linux/migrate.h>
+#include <linux/rmap.h>
 #include <linux/highmem.h>
 #include <linux/seq_file.h>
 #include <linux/magic.h>
@@ -124,13 +125,14 @@ static bool shmem_should_replace_page(struct page *page, gfp_t gfp);
 static int shmem_replace_page(struct page **pagep, gfp_t gfp,
 				struct shmem_inode_info *info, pgoff_t index);
 static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
-	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type);
+	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type,
+	struct vm_area_struct *vma);
 
 static inline int shmem_getpage(struct inode *inode, pgoff_t index,
 	struct page **pagep, enum sgp_type sgp, int *fault_type)
 {
 	return shmem_getpage_gfp(inode, index, pagep, sgp,
-			mapping_gfp_mask(inode->i_mapping), fault_type);
+			mapping_gfp_mask(inode->i_mapping), fault_type, NULL);
 }
 
 static inline struct shmem_sb_info *SHMEM_SB(struct super_block *sb)
@@ -181,6 +183,13 @@ static inline int shmem_acct_block(unsigned long flags)
 		security_vm_enough_memory_mm(current->mm, VM_ACCT(PAGE_CACHE_SIZE)) : 0;
 }
 
+static inline int shmem_acct_blocks(unsigned long flags, long pages)
+{
+	return (flags & VM_NORESERVE) ?
+		security_vm_enough_memory_mm(current->mm,
+					     pages * VM_ACCT(PAGE_CACHE_SIZE)) : 0;
+}
+
 static inline void shmem_unacct_blocks(unsigned long flags, long pages)
 {
 	if (flags & VM_NORESERVE)
@@ -901,8 +910,8 @@ static struct page *shmem_swapin(swp_entry_t swap, gfp_t gfp,
 	return page;
 }
 
-static struct page *shmem_alloc_page(gfp_t gfp,
-			struct shmem_inode_info *info, pgoff_t index)
+static struct page *shmem_alloc_pages(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t index, int order)
 {
 	struct vm_area_struct pvma;
 	struct page *page;
@@ -914,7 +923,7 @@ static struct page *shmem_alloc_page(gfp_t gfp,
 	pvma.vm_ops = NULL;
 	pvma.vm_policy = mpol_shared_policy_lookup(&info->policy, index);
 
-	page = alloc_page_vma(gfp, &pvma, 0);
+	page = alloc_pages_vma(gfp, order, &pvma, 0, numa_node_id(), false);
 
 	/* Drop reference taken by mpol_shared_policy_lookup() */
 	mpol_cond_put(pvma.vm_policy);
@@ -934,12 +943,18 @@ static inline struct page *shmem_swapin(swp_entry_t swap, gfp_t gfp,
 	return swapin_readahead(swap, gfp, NULL, 0);
 }
 
+static inline struct page *shmem_alloc_pages(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t index, int order)
+{
+	return alloc_pages(gfp, order);
+}
+#endif /* CONFIG_NUMA */
+
 static inline struct page *shmem_alloc_page(gfp_t gfp,
 			struct shmem_inode_info *info, pgoff_t index)
 {
-	return alloc_page(gfp);
+	return shmem_alloc_pages(gfp, info, index, 0);
 }
-#endif /* CONFIG_NUMA */
 
 #if !defined(CONFIG_NUMA) || !defined(CONFIG_TMPFS)
 static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
@@ -948,6 +963,188 @@ static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
 }
 #endif
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+/*
+ * With the huge= mount option, the pages of a file are allocated
+ * HPAGE_PMD_SIZE at a time, as naturally aligned, physically contiguous
+ * extents.  The extent is split into ordinary pages as soon as it is
+ * allocated, so that truncation, reclaim and swap treat them like any
+ * other shmem page; shmem_pmd_fault() maps it with one huge pmd for as
+ * long as all of it stays in the page cache.
+ */
+#define SHMEM_HUGE_NEVER	0
+#define SHMEM_HUGE_ALWAYS	1	/* for every hole */
+#define SHMEM_HUGE_WITHIN_SIZE	2	/* if the extent is within i_size */
+#define SHMEM_HUGE_ADVISE	3	/* for faults in MADV_HUGEPAGE areas */
+
+/* huge= for the internal mount: SysV shm, memfd, shared anonymous */
+static int shmem_huge __read_mostly;
+
+static int shmem_parse_huge(const char *str)
+{
+	if (!strcmp(str, "never"))
+		return SHMEM_HUGE_NEVER;
+	if (!strcmp(str, "always"))
+		return SHMEM_HUGE_ALWAYS;
+	if (!strcmp(str, "within_size"))
+		return SHMEM_HUGE_WITHIN_SIZE;
+	if (!strcmp(str, "advise"))
+		return SHMEM_HUGE_ADVISE;
+	return -EINVAL;
+}
+
+static const char *shmem_format_huge(int huge)
+{
+	switch (huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return "always";
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return "within_size";
+	case SHMEM_HUGE_ADVISE:
+		return "advise";
+	default:
+		return "never";
+	}
+}
+
+static int __init setup_shmem_huge(char *str)
+{
+	int huge = shmem_parse_huge(str);
+
+	if (huge < 0)
+		return 0;
+	shmem_huge = huge;
+	return 1;
+}
+__setup("shmem_huge=", setup_shmem_huge);
+
+static bool shmem_huge_extent(struct inode *inode, pgoff_t index,
+			      struct vm_area_struct *vma)
+{
+	pgoff_t end = round_down(index, HPAGE_PMD_NR) + HPAGE_PMD_NR;
+	bool advised = vma && (vma->vm_flags & VM_HUGEPAGE);
+
+	if (vma && (vma->vm_flags & VM_NOHUGEPAGE))
+		return false;
+
+	switch (SHMEM_SB(inode->i_sb)->huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return true;
+	case SHMEM_HUGE_WITHIN_SIZE:
+		if (end <= DIV_ROUND_UP(i_size_read(inode), PAGE_CACHE_SIZE))
+			return true;
+		/* fall through */
+	case SHMEM_HUGE_ADVISE:
+		return advised;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Called before a page is allocated for the hole at @index.  If the huge=
+ * option asks for it and the whole extent around @index is a hole, allocate
+ * the extent, add its other pages to the page cache cleared and uptodate,
+ * and return the page for @index, which the caller adds as usual.  Returns
+ * NULL to let the caller allocate a single page.
+ */
+static struct page *shmem_alloc_extent(struct inode *inode, pgoff_t index,
+				       gfp_t gfp, struct vm_area_struct *vma)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
+	pgoff_t start = round_down(index, HPAGE_PMD_NR);
+	struct page *page, *target = NULL;
+	struct mem_cgroup *memcg;
+	unsigned long indices[1];
+	void **slots[1];
+	long added = 0;
+	int i, error;
+
+	if (!shmem_huge_extent(inode, index, vma))
+		return NULL;
+
+	rcu_read_lock();
+	i = radix_tree_gang_lookup_slot(&mapping->page_tree, slots, indices,
+					start, 1);
+	rcu_read_unlock();
+	if (i && indices[0] < start + HPAGE_PMD_NR)
+		return NULL;
+
+	/* The caller accounts for the page at @index */
+	if (shmem_acct_blocks(info->flags, HPAGE_PMD_NR - 1))
+		return NULL;
+	if (sbinfo->max_blocks) {
+		if (sbinfo->max_blocks < HPAGE_PMD_NR ||
+		    percpu_counter_compare(&sbinfo->used_blocks,
+				sbinfo->max_blocks - HPAGE_PMD_NR) > 0)
+			goto unacct;
+		percpu_counter_add(&sbinfo->used_blocks, HPAGE_PMD_NR - 1);
+	}
+
+	page = shmem_alloc_pages(gfp | __GFP_NORETRY | __GFP_NOWARN,
+				 info, start, HPAGE_PMD_ORDER);
+	if (!page)
+		goto decused;
+	split_page(page, HPAGE_PMD_ORDER);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++, page++) {
+		if (start + i == index) {
+			target = page;
+			continue;
+		}
+
+		__SetPageSwapBacked(page);
+		__set_page_locked(page);
+		error = mem_cgroup_try_charge(page, current->mm, gfp, &memcg);
+		if (!error) {
+			error = radix_tree_maybe_preload(gfp & GFP_RECLAIM_MASK);
+			if (!error) {
+				error = shmem_add_to_page_cache(page, mapping,
+								start + i, NULL);
+				radix_tree_preload_end();
+			}
+			if (error) {
+				mem_cgroup_cancel_charge(page, memcg);
+			} else {
+				mem_cgroup_commit_charge(page, memcg, false);
+				lru_cache_add_anon(page);
+				clear_highpage(page);
+				flush_dcache_page(page);
+				SetPageUptodate(page);
+				added++;
+			}
+		}
+		/* Raced with another allocation, or out of memory: free it */
+		unlock_page(page);
+		page_cache_release(page);
+	}
+
+	spin_lock(&info->lock);
+	info->alloced += added;
+	inode->i_blocks += added * BLOCKS_PER_PAGE;
+	shmem_recalc_inode(inode);
+	spin_unlock(&info->lock);
+
+	if (added == HPAGE_PMD_NR - 1)
+		return target;
+decused:
+	if (sbinfo->max_blocks)
+		percpu_counter_add(&sbinfo->used_blocks,
+				   added - (HPAGE_PMD_NR - 1));
+unacct:
+	shmem_unacct_blocks(info->flags, HPAGE_PMD_NR - 1 - added);
+	return target;
+}
+#else /* !CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+static inline struct page *shmem_alloc_extent(struct inode *inode,
+		pgoff_t index, gfp_t gfp, struct vm_area_struct *vma)
+{
+	return NULL;
+}
+#endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+
 /*
  * When a page is moved from swapcache to shmem filecache (either by the
  * usual swapin of shmem_getpage_gfp(), or by the less common swapoff of
@@ -1039,7 +1236,8 @@ static int shmem_replace_page(struct page **pagep, gfp_t gfp,
  * entry since a page cannot live in both the swap and page cache
  */
 static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
-	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type)
+	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type,
+	struct vm_area_struct *vma)
 {
 	struct address_space *mapping = inode->i_mapping;
 	struct shmem_inode_info *info;
@@ -1175,7 +1373,9 @@ repeat:
 			percpu_counter_inc(&sbinfo->used_blocks);
 		}
 
-		page = shmem_alloc_page(gfp, info, index);
+		page = shmem_alloc_extent(inode, index, gfp, vma);
+		if (!page)
+			page = shmem_alloc_page(gfp, info, index);
 		if (!page) {
 			error = -ENOMEM;
 			goto decused;
@@ -1343,7 +1543,8 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		spin_unlock(&inode->i_lock);
 	}
 
-	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, SGP_CACHE, &ret);
+	error = shmem_getpage_gfp(inode, vmf->pgoff, &vmf->page, SGP_CACHE,
+				  mapping_gfp_mask(inode->i_mapping), &ret, vma);
 	if (error)
 		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
 
@@ -1354,6 +1555,135 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	return ret;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+/*
+ * Map the naturally aligned extent around @address with one huge pmd, if
+ * the huge= option allows it and the whole extent is in the page cache,
+ * physically contiguous and uptodate, as shmem_alloc_extent() leaves it.
+ * Anything else falls back to shmem_fault() and ptes.
+ */
+static int shmem_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = file_inode(vma->vm_file);
+	struct address_space *mapping = inode->i_mapping;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pgoff_t start = linear_page_index(vma, haddr);
+	struct page *page, *head = NULL;
+	int i, error, fault_type = 0;
+	spinlock_t *ptl;
+	pmd_t entry;
+
+	/* Private mappings copy-on-write single pages */
+	if (!(vma->vm_flags & VM_SHARED) ||
+	    (vma->vm_flags & (VM_LOCKED | VM_NOHUGEPAGE)))
+		return VM_FAULT_FALLBACK;
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end ||
+	    (start & (HPAGE_PMD_NR - 1)))
+		return VM_FAULT_FALLBACK;
+	/* Leave faults racing with a hole-punch to shmem_fault() */
+	if (unlikely(inode->i_private) ||
+	    !shmem_huge_extent(inode, start, vma))
+		return VM_FAULT_FALLBACK;
+
+	error = shmem_getpage_gfp(inode, linear_page_index(vma, address),
+				  &page, SGP_CACHE, mapping_gfp_mask(mapping),
+				  &fault_type, vma);
+	if (error)
+		return VM_FAULT_FALLBACK;
+	unlock_page(page);
+	page_cache_release(page);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page = find_get_page(mapping, start + i);
+		if (!page)
+			break;
+		if (!i)
+			head = page;
+		if (page_to_pfn(page) != page_to_pfn(head) + i ||
+		    !IS_ALIGNED(page_to_pfn(head), HPAGE_PMD_NR) ||
+		    !trylock_page(page)) {
+			page_cache_release(page);
+			break;
+		}
+		if (page->mapping != mapping || !PageUptodate(page)) {
+			unlock_page(page);
+			page_cache_release(page);
+			break;
+		}
+	}
+	if (i < HPAGE_PMD_NR ||
+	    start + HPAGE_PMD_NR >
+	    DIV_ROUND_UP(i_size_read(inode), PAGE_CACHE_SIZE))
+		goto out_unlock;
+
+	ptl = pmd_lock(vma->vm_mm, pmd);
+	if (unlikely(!pmd_none(*pmd))) {
+		spin_unlock(ptl);
+		goto out_unlock;
+	}
+	/* The mapping keeps the reference on each page taken above */
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		page_add_file_rmap(head + i);
+	entry = pmd_mkyoung(pmd_mkhuge(mk_pmd(head, vma->vm_page_prot)));
+	if (flags & FAULT_FLAG_WRITE)
+		entry = pmd_mkwrite(pmd_mkdirty(entry));
+	set_pmd_at(vma->vm_mm, haddr, pmd, entry);
+	update_mmu_cache_pmd(vma, address, pmd);
+	add_mm_counter(vma->vm_mm, MM_FILEPAGES, HPAGE_PMD_NR);
+	spin_unlock(ptl);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		unlock_page(head + i);
+	return 0;
+
+out_unlock:
+	while (i--) {
+		unlock_page(head + i);
+		page_cache_release(head + i);
+	}
+	return VM_FAULT_FALLBACK;
+}
+
+/*
+ * shmem_pmd_fault() needs the address of a shared mapping to sit at the
+ * same offset within a huge page as the file offset: pad the search for
+ * a free area to find such an address.
+ */
+static unsigned long shmem_get_unmapped_area(struct file *file,
+		unsigned long uaddr, unsigned long len,
+		unsigned long pgoff, unsigned long flags)
+{
+	unsigned long (*get_area)(struct file *, unsigned long,
+				  unsigned long, unsigned long, unsigned long);
+	unsigned long addr, offset, inflated_len, inflated_addr;
+
+	get_area = current->mm->get_unmapped_area;
+	addr = get_area(file, uaddr, len, pgoff, flags);
+	if (IS_ERR_VALUE(addr) || (flags & MAP_FIXED) || addr == uaddr)
+		return addr;
+	if (!(flags & MAP_SHARED) || len < HPAGE_PMD_SIZE ||
+	    SHMEM_SB(file_inode(file)->i_sb)->huge == SHMEM_HUGE_NEVER)
+		return addr;
+
+	offset = (pgoff << PAGE_SHIFT) & ~HPAGE_PMD_MASK;
+	if ((addr & ~HPAGE_PMD_MASK) == offset)
+		return addr;
+
+	inflated_len = len + HPAGE_PMD_SIZE - PAGE_SIZE;
+	if (inflated_len > TASK_SIZE || inflated_len < len)
+		return addr;
+	inflated_addr = get_area(NULL, 0, inflated_len, 0, flags);
+	if (IS_ERR_VALUE(inflated_addr))
+		return addr;
+
+	inflated_addr += (offset - inflated_addr) & ~HPAGE_PMD_MASK;
+	if (inflated_addr > TASK_SIZE - len)
+		return addr;
+	return inflated_addr;
+}
+#endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+
 #ifdef CONFIG_NUMA
 static int shmem_set_policy(struct vm_area_struct *vma, struct mempolicy *mpol)
 {
@@ -2823,6 +3153,14 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 			mpol = NULL;
 			if (mpol_parse_str(value, &mpol))
 				goto bad_val;
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+		} else if (!strcmp(this_char, "huge")) {
+			int huge = shmem_parse_huge(value);
+
+			if (huge < 0)
+				goto bad_val;
+			sbinfo->huge = huge;
+#endif
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2872,6 +3210,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 	sbinfo->max_blocks  = config.max_blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
+	sbinfo->huge = config.huge;
 
 	/*
 	 * Preserve previous mempolicy unless mpol remount option was specified.
@@ -2903,6 +3242,10 @@ static int shmem_show_options(struct seq_file *seq, struct dentry *root)
 		seq_printf(seq, ",gid=%u",
 				from_kgid_munged(&init_user_ns, sbinfo->gid));
 	shmem_show_mpol(seq, sbinfo->mpol);
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+#endif
 	return 0;
 }
 
@@ -3132,6 +3475,9 @@ static const struct address_space_operations shmem_aops = {
 
 static const struct file_operations shmem_file_operations = {
 	.mmap		= shmem_mmap,
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	.get_unmapped_area = shmem_get_unmapped_area,
+#endif
 #ifdef CONFIG_TMPFS
 	.llseek		= shmem_file_llseek,
 	.read_iter	= shmem_file_read_iter,
@@ -3208,6 +3554,9 @@ static const struct super_operations shmem_ops = {
 static const struct vm_operations_struct shmem_vm_ops = {
 	.fault		= shmem_fault,
 	.map_pages	= filemap_map_pages,
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	.pmd_fault	= shmem_pmd_fault,
+#endif
 #ifdef CONFIG_NUMA
 	.set_policy     = shmem_set_policy,
 	.get_policy     = shmem_get_policy,
@@ -3225,7 +3574,7 @@ static struct file_system_type shmem_fs_type = {
 	.name		= "tmpfs",
 	.mount		= shmem_mount,
 	.kill_sb	= kill_litter_super,
-	.fs_flags	= FS_USERNS_MOUNT,
+	.fs_flags	= FS_USERNS_MOUNT | FS_PARALLEL_LOOKUP,
 };
 
 int __init shmem_init(void)
@@ -3253,6 +3602,9 @@ int __init shmem_init(void)
 		goto out1;
 	}
 	shmem_no_idr(shm_mnt->mnt_sb);
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	SHMEM_SB(shm_mnt->mnt_sb)->huge = shmem_huge;
+#endif
 	return 0;
 
 out1:
@@ -3459,7 +3811,8 @@ struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
 	int error;
 
 	BUG_ON(mapping->a_ops != &shmem_aops);
-	error = shmem_getpage_gfp(inode, index, &page, SGP_CACHE, gfp, NULL);
+	error = shmem_getpage_gfp(inode, index, &page, SGP_CACHE, gfp, NULL,
+				  NULL);
 	if (error)
 		page = ERR_PTR(error);
 	else
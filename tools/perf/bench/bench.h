@@ -28,14 +28,22 @@
 extern int bench_numa(int argc, const char **argv, const char *prefix);
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_pipe_bw(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv,
 			    const char *prefix __maybe_unused);
 extern int bench_mem_memset(int argc, const char **argv, const char *prefix);
+extern int bench_mem_shmem(int argc, const char **argv, const char *prefix);
 extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
 extern int bench_futex_wake(int argc, const char **argv, const char *prefix);
 extern int bench_futex_wake_parallel(int argc, const char **argv,
 				     const char *prefix);
 extern int bench_futex_requeue(int argc, const char **argv, const char *prefix);
+extern int bench_fd_parallel(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_ready(int argc, const char **argv, const char *prefix);
+extern int bench_fs_inode(int argc, const char **argv, const char *prefix);
+extern int bench_fs_posix_locks(int argc, const char **argv, const char *prefix);
+extern int bench_fs_proc_lookup(int argc, const char **argv, const char *prefix);
+extern int bench_fs_lookup(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,253 @@
+/*
+ * epoll-ready: measure how fast epoll_wait() drains a large ready list.
+ *
+ * A single epoll instance watches N eventfds which are all kept readable,
+ * so every epoll_wait() call has to walk the ready list, re-poll the items
+ * and (for level-triggered watches) queue them back.  The run is repeated
+ * for 10k, 100k and 1M descriptors, unless a size is given with -n.
+ *
+ * With -w, writer threads keep signalling the eventfds while the reader
+ * drains them, which is the case where wakeups from the poll callback
+ * race with the event transfer loop.  The watches are edge-triggered in
+ * that mode, so that every reported event stands for a fresh wakeup.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+static unsigned int nfds     = 0;
+static unsigned int nsecs    = 5;
+static unsigned int nwriters = 0;
+static unsigned int maxevents = 1024;
+static bool done = false, interrupted = false;
+
+static const unsigned int default_sizes[] = { 10000, 100000, 1000000 };
+
+struct writer {
+	pthread_t thread;
+	unsigned int seed;
+	int *fds;
+	unsigned int nr;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('n', "nfds",      &nfds,      "Specify amount of ready descriptors (default: 10k, 100k and 1M)"),
+	OPT_UINTEGER('r', "runtime",   &nsecs,     "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('w', "writers",   &nwriters,  "Specify amount of writer threads (edge-triggered)"),
+	OPT_UINTEGER('m', "maxevents", &maxevents, "Specify maxevents for each epoll_wait() call"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ready_usage[] = {
+	"perf bench epoll ready <options>",
+	NULL
+};
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	done = true;
+}
+
+static void toggle_interrupted(int sig __maybe_unused,
+			       siginfo_t *info __maybe_unused,
+			       void *uc __maybe_unused)
+{
+	done = interrupted = true;
+}
+
+static void *writerfn(void *arg)
+{
+	struct writer *w = (struct writer *) arg;
+	const uint64_t one = 1;
+
+	while (!done) {
+		int fd = w->fds[rand_r(&w->seed) % w->nr];
+
+		if (write(fd, &one, sizeof(one)) == sizeof(one))
+			w->ops++;
+	}
+	return NULL;
+}
+
+/* Make room for @nr more descriptors, returns false if we cannot. */
+static bool raise_nofile(unsigned int nr)
+{
+	struct rlimit rl;
+	rlim_t want = nr + 64;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl))
+		return false;
+	if (rl.rlim_cur >= want)
+		return true;
+	if (rl.rlim_max < want)
+		rl.rlim_max = want;
+	rl.rlim_cur = want;
+	return !setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static void close_fds(int *fds, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		close(fds[i]);
+}
+
+static int run_step(unsigned int nr, struct epoll_event *events)
+{
+	struct timeval start, end, runtime;
+	struct writer *writer = NULL;
+	unsigned long nevents = 0, ncalls = 0, wops = 0;
+	const uint64_t one = 1;
+	double secs;
+	unsigned int i, nopen = 0;
+	int epfd, *fds;
+
+	if (!raise_nofile(nr)) {
+		printf("%10u %16s\n", nr, "skipped (RLIMIT_NOFILE)");
+		return 0;
+	}
+
+	fds = calloc(nr, sizeof(*fds));
+	if (!fds)
+		err(EXIT_FAILURE, "calloc");
+
+	epfd = epoll_create1(0);
+	if (epfd < 0)
+		err(EXIT_FAILURE, "epoll_create1");
+
+	for (i = 0; i < nr; i++) {
+		struct epoll_event ev = {
+			.events = EPOLLIN | (nwriters ? EPOLLET : 0),
+			.data.u32 = i,
+		};
+
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0) {
+			printf("%10u %16s\n", nr, "skipped (eventfd)");
+			goto out;
+		}
+		if (write(fds[i], &one, sizeof(one)) != sizeof(one))
+			err(EXIT_FAILURE, "write");
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev)) {
+			close(fds[i]);
+			if (errno != ENOSPC)
+				err(EXIT_FAILURE, "epoll_ctl");
+			printf("%10u %16s\n", nr, "skipped (max_user_watches)");
+			goto out;
+		}
+		nopen++;
+	}
+
+	done = interrupted;
+	if (nwriters) {
+		writer = calloc(nwriters, sizeof(*writer));
+		if (!writer)
+			err(EXIT_FAILURE, "calloc");
+		for (i = 0; i < nwriters; i++) {
+			writer[i].seed = i + 1;
+			writer[i].fds = fds;
+			writer[i].nr = nr;
+			if (pthread_create(&writer[i].thread, NULL, writerfn,
+					   &writer[i]))
+				err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+
+	alarm(nsecs);
+	gettimeofday(&start, NULL);
+	while (!done) {
+		int ret = epoll_wait(epfd, events, maxevents, 0);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "epoll_wait");
+		}
+		nevents += ret;
+		ncalls++;
+	}
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+
+	for (i = 0; i < nwriters; i++) {
+		if (pthread_join(writer[i].thread, NULL))
+			err(EXIT_FAILURE, "pthread_join");
+		wops += writer[i].ops;
+	}
+	free(writer);
+
+	secs = runtime.tv_sec + runtime.tv_usec / 1e6;
+	printf("%10u %16.0f %16.0f", nr, nevents / secs, ncalls / secs);
+	if (nwriters)
+		printf(" %16.0f", wops / secs);
+	printf("\n");
+
+out:
+	close_fds(fds, nopen);
+	close(epfd);
+	free(fds);
+	return 0;
+}
+
+int bench_epoll_ready(int argc, const char **argv,
+		      const char *prefix __maybe_unused)
+{
+	struct sigaction act;
+	struct epoll_event *events;
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options, bench_epoll_ready_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_ready_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!nsecs)
+		nsecs = 1;
+	if (!maxevents)
+		maxevents = 1;
+
+	sigfillset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGALRM, &act, NULL);
+	act.sa_sigaction = toggle_interrupted;
+	sigaction(SIGINT, &act, NULL);
+
+	events = calloc(maxevents, sizeof(*events));
+	if (!events)
+		err(EXIT_FAILURE, "calloc");
+
+	printf("Run summary [PID %d]: %s-triggered eventfds, maxevents %d, %d writer threads, %d secs per step.\n\n",
+	       getpid(), nwriters ? "edge" : "level", maxevents, nwriters, nsecs);
+
+	printf("%10s %16s %16s", "fds", "events/sec", "waits/sec");
+	if (nwriters)
+		printf(" %16s", "writes/sec");
+	printf("\n");
+
+	if (nfds)
+		run_step(nfds, events);
+	else
+		for (i = 0; i < ARRAY_SIZE(default_sizes) && !interrupted; i++)
+			run_step(default_sizes[i], events);
+
+	free(events);
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * fd-parallel: measure descriptor table scalability.
+ *
+ * N threads sharing one files_struct repeatedly allocate and release
+ * descriptors (dup()/close() of a private descriptor by default, or
+ * open()/close() of /dev/null), which is what accept()-heavy servers do
+ * to the table.  The run is repeated for 1, 2, 4, ... up to the requested
+ * number of threads so that the scaling curve of __alloc_fd()/__close_fd()
+ * can be read off directly.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "scaling.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+static struct scaling_bench sb = {
+	.nsecs		= 5,
+};
+/* descriptors held open by each thread, to put some weight in the table */
+static unsigned int nfds     = 64;
+static bool use_open = false;
+
+struct worker {
+	int base_fd;
+	int *fds;
+};
+
+static struct worker *worker;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &sb.nthreads, "Specify maximum amount of threads"),
+	OPT_UINTEGER('r', "runtime", &sb.nsecs,    "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('f', "fds",     &nfds,        "Specify amount of descriptors cycled per thread"),
+	OPT_BOOLEAN( 'o', "open",    &use_open,    "Use open(/dev/null) instead of dup()"),
+	OPT_BOOLEAN( 's', "silent",  &sb.silent,   "Silent mode: do not display per-thread data"),
+	OPT_END()
+};
+
+static const char * const bench_fd_parallel_usage[] = {
+	"perf bench fd parallel <options>",
+	NULL
+};
+
+static int get_fd(struct worker *w)
+{
+	if (use_open)
+		return open("/dev/null", O_RDONLY);
+	return dup(w->base_fd);
+}
+
+static void work(unsigned int tid, unsigned long *ops)
+{
+	struct worker *w = &worker[tid];
+	unsigned int i;
+
+	for (i = 0; i < nfds; i++) {
+		w->fds[i] = get_fd(w);
+		if (w->fds[i] < 0)
+			err(EXIT_FAILURE, "dup");
+	}
+
+	do {
+		for (i = 0; i < nfds; i++, (*ops)++) {
+			close(w->fds[i]);
+			w->fds[i] = get_fd(w);
+			if (w->fds[i] < 0)
+				err(EXIT_FAILURE, "dup");
+		}
+	} while (!scaling_done);
+
+	for (i = 0; i < nfds; i++)
+		close(w->fds[i]);
+}
+
+int bench_fd_parallel(int argc, const char **argv,
+		      const char *prefix __maybe_unused)
+{
+	struct rlimit rl;
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options, bench_fd_parallel_usage, 0);
+	if (argc) {
+		usage_with_options(bench_fd_parallel_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	sb.work = work;
+	scaling_init(&sb);
+
+	/* make room for nthreads * nfds descriptors */
+	if (!getrlimit(RLIMIT_NOFILE, &rl)) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	worker = calloc(sb.nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < sb.nthreads; i++) {
+		worker[i].fds = calloc(nfds, sizeof(*worker[i].fds));
+		if (!worker[i].fds)
+			err(EXIT_FAILURE, "calloc");
+		worker[i].base_fd = open("/dev/null", O_RDONLY);
+		if (worker[i].base_fd < 0)
+			err(EXIT_FAILURE, "open");
+	}
+
+	printf("Run summary [PID %d]: up to %d threads, each cycling %d descriptors with %s()/close() for %d secs per step.\n\n",
+	       getpid(), sb.nthreads, nfds, use_open ? "open" : "dup", sb.nsecs);
+
+	scaling_run(&sb);
+
+	for (i = 0; i < sb.nthreads; i++) {
+		close(worker[i].base_fd);
+		free(worker[i].fds);
+	}
+	free(worker);
+	return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * fs-inode: measure inode cache scalability.
+ *
+ * N threads churn the inode hash of the file system holding the target
+ * directory.  By default each thread creates, fstat()s and unlinks files
+ * in a private subdirectory, so every operation inserts an inode into
+ * the hash and removes it again.  With -H, each thread instead looks up a
+ * fixed set of files through open_by_handle_at(), which goes straight to
+ * the file system's iget and so exercises hash lookups of cached inodes
+ * (this needs CAP_DAC_READ_SEARCH and a file system that supports file
+ * handles).
+ *
+ * Note that file systems which do not hash their inodes (tmpfs, for one)
+ * will not tell you anything about the inode hash; use a disk file system.
+ * The run is repeated for 1, 2, 4, ... up to the requested number of
+ * threads.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "scaling.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+static struct scaling_bench sb = {
+	.nsecs		= 5,
+};
+static unsigned int nfiles   = 64;
+static const char *dirname_opt = ".";
+static bool use_handles = false;
+
+static char topdir[PATH_MAX];
+static int topfd;
+
+struct worker {
+	int tid;
+	int dirfd;
+	struct file_handle **handles;
+};
+
+static struct worker *worker;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &sb.nthreads, "Specify maximum amount of threads"),
+	OPT_UINTEGER('r', "runtime", &sb.nsecs,    "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('f', "files",   &nfiles,      "Specify amount of files cycled per thread"),
+	OPT_STRING(  'd', "dir",     &dirname_opt, "dir", "Specify directory to work in (default: .)"),
+	OPT_BOOLEAN( 'H', "handles", &use_handles, "Look up files with open_by_handle_at() instead of creating them"),
+	OPT_BOOLEAN( 's', "silent",  &sb.silent,   "Silent mode: do not display per-thread data"),
+	OPT_END()
+};
+
+static const char * const bench_fs_inode_usage[] = {
+	"perf bench fs inode <options>",
+	NULL
+};
+
+static void create_one(struct worker *w, unsigned int i)
+{
+	char name[32];
+	struct stat st;
+	int fd;
+
+	snprintf(name, sizeof(name), "f%u", i);
+	fd = openat(w->dirfd, name, O_CREAT | O_EXCL | O_WRONLY, 0600);
+	if (fd < 0)
+		err(EXIT_FAILURE, "openat");
+	if (fstat(fd, &st))
+		err(EXIT_FAILURE, "fstat");
+	close(fd);
+	if (unlinkat(w->dirfd, name, 0))
+		err(EXIT_FAILURE, "unlinkat");
+}
+
+static void lookup_one(struct worker *w, unsigned int i)
+{
+	struct stat st;
+	int fd;
+
+	fd = open_by_handle_at(w->dirfd, w->handles[i], O_RDONLY);
+	if (fd < 0)
+		err(EXIT_FAILURE, "open_by_handle_at");
+	if (fstat(fd, &st))
+		err(EXIT_FAILURE, "fstat");
+	close(fd);
+}
+
+static void work(unsigned int tid, unsigned long *ops)
+{
+	struct worker *w = &worker[tid];
+	unsigned int i;
+
+	do {
+		for (i = 0; i < nfiles && !scaling_done; i++, (*ops)++) {
+			if (use_handles)
+				lookup_one(w, i);
+			else
+				create_one(w, i);
+		}
+	} while (!scaling_done);
+}
+
+/* Create the files of @w and record their handles. */
+static bool setup_handles(struct worker *w)
+{
+	unsigned int i;
+	int fd;
+
+	w->handles = calloc(nfiles, sizeof(*w->handles));
+	if (!w->handles)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nfiles; i++) {
+		struct file_handle *fh;
+		char name[32];
+		int mnt_id;
+
+		snprintf(name, sizeof(name), "f%u", i);
+		fd = openat(w->dirfd, name, O_CREAT | O_WRONLY, 0600);
+		if (fd < 0)
+			err(EXIT_FAILURE, "openat");
+		close(fd);
+
+		fh = malloc(sizeof(*fh) + MAX_HANDLE_SZ);
+		if (!fh)
+			err(EXIT_FAILURE, "malloc");
+		fh->handle_bytes = MAX_HANDLE_SZ;
+		if (name_to_handle_at(w->dirfd, name, fh, &mnt_id, 0)) {
+			free(fh);
+			return false;
+		}
+		w->handles[i] = fh;
+	}
+
+	/* Check that we may use them */
+	fd = open_by_handle_at(w->dirfd, w->handles[0], O_RDONLY);
+	if (fd < 0)
+		return false;
+	close(fd);
+	return true;
+}
+
+static void cleanup_worker(struct worker *w)
+{
+	char name[32];
+	unsigned int i;
+
+	for (i = 0; i < nfiles; i++) {
+		snprintf(name, sizeof(name), "f%u", i);
+		unlinkat(w->dirfd, name, 0);
+		if (w->handles)
+			free(w->handles[i]);
+	}
+	free(w->handles);
+	close(w->dirfd);
+	snprintf(name, sizeof(name), "t%d", w->tid);
+	unlinkat(topfd, name, AT_REMOVEDIR);
+}
+
+int bench_fs_inode(int argc, const char **argv,
+		   const char *prefix __maybe_unused)
+{
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options, bench_fs_inode_usage, 0);
+	if (argc) {
+		usage_with_options(bench_fs_inode_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	sb.work = work;
+	scaling_init(&sb);
+
+	if (!nfiles)
+		nfiles = 1;
+
+	snprintf(topdir, sizeof(topdir), "%s/perf-bench-inode.%d",
+		 dirname_opt, getpid());
+	if (mkdir(topdir, 0700))
+		err(EXIT_FAILURE, "%s", topdir);
+	topfd = open(topdir, O_RDONLY | O_DIRECTORY);
+	if (topfd < 0)
+		err(EXIT_FAILURE, "%s", topdir);
+
+	worker = calloc(sb.nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < sb.nthreads; i++) {
+		char name[32];
+
+		worker[i].tid = i;
+		snprintf(name, sizeof(name), "t%d", i);
+		if (mkdirat(topfd, name, 0700))
+			err(EXIT_FAILURE, "mkdirat");
+		worker[i].dirfd = openat(topfd, name, O_RDONLY | O_DIRECTORY);
+		if (worker[i].dirfd < 0)
+			err(EXIT_FAILURE, "open");
+		if (use_handles && !setup_handles(&worker[i])) {
+			printf("open_by_handle_at() not usable here (%s), skipping\n",
+			       strerror(errno));
+			sb.nthreads = i + 1;
+			goto out;
+		}
+	}
+
+	printf("Run summary [PID %d]: up to %d threads, each %s %d files in %s for %d secs per step.\n\n",
+	       getpid(), sb.nthreads,
+	       use_handles ? "looking up" : "creating and unlinking",
+	       nfiles, dirname_opt, sb.nsecs);
+
+	scaling_run(&sb);
+
+out:
+	for (i = 0; i < sb.nthreads; i++)
+		cleanup_worker(&worker[i]);
+	free(worker);
+	close(topfd);
+	rmdir(topdir);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * fs-lookup: measure parallel lookups of different names in one directory.
+ *
+ * A directory with N entries (1M by default) is filled with empty files,
+ * then threads keep stat()ing random names in it.  Names which miss the
+ * dcache go down to the file system's ->lookup(), which used to be
+ * serialized by the directory's i_mutex, so this shows whether such
+ * lookups scale on a file system flagged FS_PARALLEL_LOOKUP.  With -m every
+ * name looked up is a new one which does not exist, so that every lookup
+ * misses the dcache; otherwise the dcache is dropped before each step when
+ * running as root, and the lookups miss until the directory is cached.
+ * The run is repeated for 1, 2, 4, ... up to the requested number of
+ * threads.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "scaling.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+static struct scaling_bench sb = {
+	.nsecs		= 5,
+};
+static unsigned int nentries = 1000000;
+static const char *dirname_opt = ".";
+static bool missing = false;
+
+static char dir[PATH_MAX];
+static int dirfd;
+
+/* rand_r() state of each thread, reseeded at each step */
+static unsigned int *seeds;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &sb.nthreads, "Specify maximum amount of threads"),
+	OPT_UINTEGER('r', "runtime", &sb.nsecs,    "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('n', "entries", &nentries,    "Specify amount of entries in the directory (default: 1M)"),
+	OPT_STRING(  'd', "dir",     &dirname_opt, "dir", "Specify directory to create the test directory in (default: .)"),
+	OPT_BOOLEAN( 'm', "missing", &missing,     "Look up names which do not exist, so that every lookup misses the dcache"),
+	OPT_BOOLEAN( 's', "silent",  &sb.silent,   "Silent mode: do not display per-thread data"),
+	OPT_END()
+};
+
+static const char * const bench_fs_lookup_usage[] = {
+	"perf bench fs lookup <options>",
+	NULL
+};
+
+static void work(unsigned int tid, unsigned long *ops)
+{
+	unsigned int *seed = &seeds[tid];
+	unsigned long n = 0;
+	char name[48];
+	struct stat st;
+
+	while (!scaling_done) {
+		if (missing) {
+			/* unique across threads and steps */
+			snprintf(name, sizeof(name), "m%u.%d.%lu",
+				 *seed, tid, n++);
+			if (!fstatat(dirfd, name, &st, 0))
+				errx(EXIT_FAILURE, "%s exists", name);
+			if (errno != ENOENT)
+				err(EXIT_FAILURE, "fstatat %s", name);
+		} else {
+			snprintf(name, sizeof(name), "f%u",
+				 rand_r(seed) % nentries);
+			if (fstatat(dirfd, name, &st, 0))
+				err(EXIT_FAILURE, "fstatat %s", name);
+		}
+		(*ops)++;
+	}
+}
+
+static void populate(void)
+{
+	char name[32];
+	unsigned int i;
+	int fd;
+
+	snprintf(dir, sizeof(dir), "%s/perf-bench-lookup.%d",
+		 dirname_opt, getpid());
+	if (mkdir(dir, 0700))
+		err(EXIT_FAILURE, "%s", dir);
+	dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0)
+		err(EXIT_FAILURE, "%s", dir);
+
+	for (i = 0; i < nentries; i++) {
+		snprintf(name, sizeof(name), "f%u", i);
+		fd = openat(dirfd, name, O_CREAT | O_EXCL | O_WRONLY, 0600);
+		if (fd < 0)
+			err(EXIT_FAILURE, "openat %s", name);
+		close(fd);
+	}
+}
+
+static void cleanup(void)
+{
+	char name[32];
+	unsigned int i;
+
+	for (i = 0; i < nentries; i++) {
+		snprintf(name, sizeof(name), "f%u", i);
+		unlinkat(dirfd, name, 0);
+	}
+	close(dirfd);
+	rmdir(dir);
+}
+
+/* Start a step with a cold dcache, if we are allowed to */
+static void drop_dentries(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0)
+		return;
+	if (write(fd, "2", 1) != 1)
+		warn("drop_caches");
+	close(fd);
+}
+
+static void prepare(unsigned int nr, unsigned int step)
+{
+	unsigned int i;
+
+	if (!missing)
+		drop_dentries();
+
+	for (i = 0; i < nr; i++)
+		seeds[i] = step * sb.nthreads + i + 1;
+}
+
+int bench_fs_lookup(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+
+	argc = parse_options(argc, argv, options, bench_fs_lookup_usage, 0);
+	if (argc) {
+		usage_with_options(bench_fs_lookup_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	sb.work = work;
+	sb.prepare = prepare;
+	scaling_init(&sb);
+
+	if (!nentries)
+		nentries = 1;
+
+	seeds = calloc(sb.nthreads, sizeof(*seeds));
+	if (!seeds)
+		err(EXIT_FAILURE, "calloc");
+
+	printf("Run summary [PID %d]: up to %d threads, each looking up %s names in a directory of %d entries for %d secs per step.\n\n",
+	       getpid(), sb.nthreads, missing ? "missing" : "random", nentries, sb.nsecs);
+
+	populate();
+
+	scaling_run(&sb);
+
+	cleanup();
+	free(seeds);
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * fs-posix-locks: measure byte-range lock acquisition on a file that
+ * already carries many locks.
+ *
+ * A holder sets read locks on every other record of a file, so the file
+ * carries N locks which cannot be merged.  Then N threads keep write
+ * locking and unlocking random free records in between, each through an
+ * open file of its own (OFD locks, so that the threads do not share one
+ * lock owner).  Every lock and unlock has to find the locks around the
+ * record, so this shows how the cost of a lock operation scales with the
+ * number of locks on the file.  The run is repeated for 1k, 10k and 100k
+ * held locks, unless a number is given with -n.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#ifndef F_OFD_SETLK
+#define F_OFD_GETLK	36
+#define F_OFD_SETLK	37
+#define F_OFD_SETLKW	38
+#endif
+
+#define RECORD_SIZE	64
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 5;
+static unsigned int nlocks   = 0;
+static const char *dirname_opt = ".";
+static bool done = false, interrupted = false;
+
+static const unsigned int default_sizes[] = { 1000, 10000, 100000 };
+
+static char path[PATH_MAX];
+
+struct worker {
+	pthread_t thread;
+	unsigned int seed;
+	int fd;
+	unsigned int nr;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,    "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,       "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('n', "locks",   &nlocks,      "Specify amount of held locks (default: 1k, 10k and 100k)"),
+	OPT_STRING(  'd', "dir",     &dirname_opt, "dir", "Specify directory to create the file in (default: .)"),
+	OPT_END()
+};
+
+static const char * const bench_fs_posix_locks_usage[] = {
+	"perf bench fs posix-locks <options>",
+	NULL
+};
+
+static void toggle_interrupted(int sig __maybe_unused,
+			       siginfo_t *info __maybe_unused,
+			       void *uc __maybe_unused)
+{
+	done = interrupted = true;
+}
+
+static int set_lock(int fd, int cmd, short type, unsigned int record)
+{
+	struct flock fl = {
+		.l_type = type,
+		.l_whence = SEEK_SET,
+		.l_start = (off_t) record * RECORD_SIZE,
+		.l_len = RECORD_SIZE,
+	};
+
+	return fcntl(fd, cmd, &fl);
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+
+	while (!done) {
+		/* the odd records are free */
+		unsigned int record = 2 * (rand_r(&w->seed) % w->nr) + 1;
+
+		if (set_lock(w->fd, F_OFD_SETLKW, F_WRLCK, record)) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "F_OFD_SETLKW");
+		}
+		if (set_lock(w->fd, F_OFD_SETLK, F_UNLCK, record))
+			err(EXIT_FAILURE, "F_OFD_SETLK");
+		w->ops++;
+	}
+	return NULL;
+}
+
+static void run_step(struct worker *worker, unsigned int nr)
+{
+	struct timeval start, end, runtime;
+	unsigned long ops = 0;
+	unsigned int i;
+	double secs;
+	int holder;
+
+	/* A fresh open file drops the locks of the previous step */
+	holder = open(path, O_RDWR);
+	if (holder < 0)
+		err(EXIT_FAILURE, "open");
+	for (i = 0; i < nr; i++) {
+		if (set_lock(holder, F_OFD_SETLK, F_RDLCK, 2 * i)) {
+			if (errno == EINVAL) {
+				printf("OFD locks not supported, skipping\n");
+				interrupted = true;
+				close(holder);
+				return;
+			}
+			err(EXIT_FAILURE, "F_OFD_SETLK");
+		}
+	}
+
+	done = interrupted;
+	for (i = 0; i < nthreads; i++) {
+		worker[i].nr = nr;
+		worker[i].ops = 0;
+		if (pthread_create(&worker[i].thread, NULL, workerfn,
+				   &worker[i]))
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	gettimeofday(&start, NULL);
+	sleep(nsecs);
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_join(worker[i].thread, NULL))
+			err(EXIT_FAILURE, "pthread_join");
+		ops += worker[i].ops;
+	}
+	close(holder);
+
+	secs = runtime.tv_sec + runtime.tv_usec / 1e6;
+	printf("%10u %16.0f %16.0f\n", nr, ops / secs, ops / secs / nthreads);
+}
+
+int bench_fs_posix_locks(int argc, const char **argv,
+			 const char *prefix __maybe_unused)
+{
+	struct sigaction act;
+	struct worker *worker;
+	unsigned int i;
+	int fd;
+
+	argc = parse_options(argc, argv, options, bench_fs_posix_locks_usage, 0);
+	if (argc) {
+		usage_with_options(bench_fs_posix_locks_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (!nsecs)
+		nsecs = 1;
+
+	sigfillset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_sigaction = toggle_interrupted;
+	sigaction(SIGINT, &act, NULL);
+
+	snprintf(path, sizeof(path), "%s/perf-bench-locks.%d",
+		 dirname_opt, getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		err(EXIT_FAILURE, "%s", path);
+	close(fd);
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+	for (i = 0; i < nthreads; i++) {
+		worker[i].seed = i + 1;
+		worker[i].fd = open(path, O_RDWR);
+		if (worker[i].fd < 0)
+			err(EXIT_FAILURE, "open");
+	}
+
+	printf("Run summary [PID %d]: %d threads locking %d byte records in %s, %d secs per step.\n\n",
+	       getpid(), nthreads, RECORD_SIZE, dirname_opt, nsecs);
+	printf("%10s %16s %16s\n", "locks", "ops/sec", "ops/sec/thread");
+
+	if (nlocks)
+		run_step(worker, nlocks);
+	else
+		for (i = 0; i < ARRAY_SIZE(default_sizes) && !interrupted; i++)
+			run_step(worker, default_sizes[i]);
+
+	for (i = 0; i < nthreads; i++)
+		close(worker[i].fd);
+	free(worker);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * fs-proc-lookup: measure path lookup scalability in proc and sysfs.
+ *
+ * N threads keep stat()ing the files of one directory by their full path,
+ * the way process monitors poll /proc/<pid>/...  Every stat() walks all
+ * the components of the path, so this shows whether lookups in the
+ * directory can stay in RCU-walk mode or keep bouncing the reference
+ * counts and locks of the shared dentries between CPUs.  The directory is
+ * /proc/<pid> of the benchmark itself unless another one, such as a sysfs
+ * directory, is given with -p.  The run is repeated for 1, 2, 4, ... up to
+ * the requested number of threads.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "scaling.h"
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define MAX_PATHS	64
+
+static struct scaling_bench sb = {
+	.nsecs		= 5,
+};
+static const char *path_opt = NULL;
+
+static char *paths[MAX_PATHS];
+static unsigned int npaths;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &sb.nthreads, "Specify maximum amount of threads"),
+	OPT_UINTEGER('r', "runtime", &sb.nsecs,    "Specify runtime of each step (in seconds)"),
+	OPT_STRING(  'p', "path",    &path_opt,    "dir", "Specify directory whose files are looked up (default: /proc/<pid>)"),
+	OPT_BOOLEAN( 's', "silent",  &sb.silent,   "Silent mode: do not display per-thread data"),
+	OPT_END()
+};
+
+static const char * const bench_fs_proc_lookup_usage[] = {
+	"perf bench fs proc-lookup <options>",
+	NULL
+};
+
+static void work(unsigned int tid __maybe_unused, unsigned long *ops)
+{
+	struct stat st;
+	unsigned int i;
+
+	do {
+		for (i = 0; i < npaths && !scaling_done; i++, (*ops)++) {
+			if (stat(paths[i], &st))
+				err(EXIT_FAILURE, "stat %s", paths[i]);
+		}
+	} while (!scaling_done);
+}
+
+/* Collect the regular files of @dir which can be stat()ed. */
+static void collect_paths(const char *dir)
+{
+	struct dirent *de;
+	struct stat st;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		err(EXIT_FAILURE, "%s", dir);
+
+	while (npaths < MAX_PATHS && (de = readdir(d))) {
+		char *path;
+
+		if (asprintf(&path, "%s/%s", dir, de->d_name) < 0)
+			err(EXIT_FAILURE, "asprintf");
+		if (lstat(path, &st) || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		paths[npaths++] = path;
+	}
+	closedir(d);
+
+	if (!npaths)
+		errx(EXIT_FAILURE, "no files in %s", dir);
+}
+
+int bench_fs_proc_lookup(int argc, const char **argv,
+			 const char *prefix __maybe_unused)
+{
+	unsigned int i;
+	char dir[PATH_MAX];
+
+	argc = parse_options(argc, argv, options, bench_fs_proc_lookup_usage, 0);
+	if (argc) {
+		usage_with_options(bench_fs_proc_lookup_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	sb.work = work;
+	scaling_init(&sb);
+
+	/* Not /proc/self, following that symlink always leaves RCU-walk */
+	if (path_opt)
+		snprintf(dir, sizeof(dir), "%s", path_opt);
+	else
+		snprintf(dir, sizeof(dir), "/proc/%d", getpid());
+	collect_paths(dir);
+
+	printf("Run summary [PID %d]: up to %d threads, each looking up %d files in %s for %d secs per step.\n\n",
+	       getpid(), sb.nthreads, npaths, dir, sb.nsecs);
+
+	scaling_run(&sb);
+
+	for (i = 0; i < npaths; i++)
+		free(paths[i]);
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * mem-shmem: measure faults and TLB reach on a shared memory mapping.
+ *
+ * A tmpfs file (in /dev/shm unless another directory is given with -d,
+ * or a memfd with -m) is mapped shared and every page of it is written
+ * once, which shows how many page faults it takes to populate the mapping
+ * and how long they take.  Then a pointer chain which visits the pages in
+ * random order is followed, one dependent load per page, so that nearly
+ * every access misses the TLB: the time per access shows what the page
+ * table walks cost.  Compare tmpfs mounts with and without the huge=
+ * option, or use -a to madvise(MADV_HUGEPAGE) the mapping for huge=advise.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE	14
+#endif
+
+#define LINE_SIZE	64
+
+static unsigned int size_mb  = 1024;
+static unsigned int naccess  = 10000000;
+static const char *dirname_opt = "/dev/shm";
+static bool use_memfd = false, advise = false;
+static void * volatile sink;
+
+static const struct option options[] = {
+	OPT_UINTEGER('s', "size",     &size_mb,     "Specify size of the mapping (in MB)"),
+	OPT_UINTEGER('l', "accesses", &naccess,     "Specify amount of random accesses"),
+	OPT_STRING(  'd', "dir",      &dirname_opt, "dir", "Specify tmpfs directory to create the file in (default: /dev/shm)"),
+	OPT_BOOLEAN( 'm', "memfd",    &use_memfd,   "Use a memfd instead of a file"),
+	OPT_BOOLEAN( 'a', "advise",   &advise,      "madvise(MADV_HUGEPAGE) the mapping"),
+	OPT_END()
+};
+
+static const char * const bench_mem_shmem_usage[] = {
+	"perf bench mem shmem <options>",
+	NULL
+};
+
+static int open_memfd(void)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, "perf-bench-shmem", 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static long faults(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+static double elapsed(struct timeval *start)
+{
+	struct timeval end, runtime;
+
+	gettimeofday(&end, NULL);
+	timersub(&end, start, &runtime);
+	return runtime.tv_sec + runtime.tv_usec / 1e6;
+}
+
+int bench_mem_shmem(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+	char path[PATH_MAX] = "";
+	unsigned long npages, i, *order;
+	size_t page_size, size;
+	struct timeval start;
+	long nfaults;
+	double secs;
+	char *map;
+	void **p;
+	int fd;
+
+	argc = parse_options(argc, argv, options, bench_mem_shmem_usage, 0);
+	if (argc) {
+		usage_with_options(bench_mem_shmem_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!size_mb)
+		size_mb = 1;
+	page_size = sysconf(_SC_PAGESIZE);
+	size = (size_t)size_mb << 20;
+	npages = size / page_size;
+
+	if (use_memfd) {
+		fd = open_memfd();
+		if (fd < 0)
+			err(EXIT_FAILURE, "memfd_create");
+	} else {
+		snprintf(path, sizeof(path), "%s/perf-bench-shmem.%d",
+			 dirname_opt, getpid());
+		fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			err(EXIT_FAILURE, "%s", path);
+	}
+	if (ftruncate(fd, size))
+		err(EXIT_FAILURE, "ftruncate");
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+	if (advise && madvise(map, size, MADV_HUGEPAGE))
+		warn("madvise");
+
+	printf("Run summary [PID %d]: %u MB mapped from %s, %u random accesses.\n\n",
+	       getpid(), size_mb, use_memfd ? "a memfd" : dirname_opt, naccess);
+
+	/* Visit the pages in random order, at a random line in each */
+	order = calloc(npages, sizeof(*order));
+	if (!order)
+		err(EXIT_FAILURE, "calloc");
+	for (i = 0; i < npages; i++)
+		order[i] = i;
+	srand(getpid());
+	for (i = npages - 1; i > 0; i--) {
+		unsigned long j = rand() % (i + 1), t = order[i];
+
+		order[i] = order[j];
+		order[j] = t;
+	}
+	for (i = 0; i < npages; i++)
+		order[i] = order[i] * page_size +
+			(rand() % (page_size / LINE_SIZE)) * LINE_SIZE;
+
+	nfaults = faults();
+	gettimeofday(&start, NULL);
+	for (i = 0; i < npages; i++)
+		*(void **)(map + order[i]) =
+			map + order[(i + 1) % npages];
+	secs = elapsed(&start);
+	nfaults = faults() - nfaults;
+	p = (void **)(map + order[0]);
+	free(order);
+
+	printf("%14s: %ld faults for %lu pages, %.1f pages/fault\n",
+	       "populate", nfaults, npages,
+	       nfaults ? (double)npages / nfaults : 0.0);
+	printf("%14s: %.3f secs, %.0f ns/page\n", "",
+	       secs, secs * 1e9 / npages);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < naccess; i++)
+		p = *p;
+	secs = elapsed(&start);
+	sink = p;
+
+	printf("%14s: %.3f secs, %.1f ns/access\n", "random access",
+	       secs, secs * 1e9 / naccess);
+
+	munmap(map, size);
+	close(fd);
+	if (*path)
+		unlink(path);
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * scaling: the thread harness shared by the scalability benchmarks.
+ *
+ * Each step starts nr threads, each bound to a CPU, lets them loop for
+ * nsecs seconds and sums up their throughput; the steps go 1, 2, 4, ...
+ * up to nthreads, and the result of each one is printed relative to the
+ * single threaded one.  A SIGINT ends the current step and the run.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "scaling.h"
+
+#include <err.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+volatile bool scaling_done;
+static volatile bool interrupted;
+
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct scaling_thread {
+	struct scaling_bench *sb;
+	unsigned int tid;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static void *workerfn(void *arg)
+{
+	struct scaling_thread *t = arg;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	t->sb->work(t->tid, &t->ops);
+	return NULL;
+}
+
+static void toggle_interrupted(int sig __maybe_unused,
+			       siginfo_t *info __maybe_unused,
+			       void *uc __maybe_unused)
+{
+	scaling_done = interrupted = true;
+}
+
+/*
+ * Fill in the defaults of @sb, so that the caller can size its per-thread
+ * data by sb->nthreads, and catch SIGINT.
+ */
+void scaling_init(struct scaling_bench *sb)
+{
+	struct sigaction act;
+
+	sigfillset(&act.sa_mask);
+	act.sa_flags = SA_SIGINFO;
+	act.sa_sigaction = toggle_interrupted;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!sb->nthreads) /* default to the number of CPUs */
+		sb->nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (!sb->nsecs)
+		sb->nsecs = 1;
+}
+
+static unsigned long run_step(struct scaling_bench *sb,
+			      struct scaling_thread *threads, unsigned int nr,
+			      unsigned int ncpus)
+{
+	struct timeval start, end, runtime;
+	pthread_attr_t thread_attr;
+	unsigned long total = 0;
+	unsigned int i;
+	cpu_set_t cpu;
+	double secs;
+	int ret;
+
+	/* a SIGINT during ->prepare() must not be forgotten */
+	scaling_done = interrupted;
+	threads_starting = nr;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nr; i++) {
+		threads[i].sb = sb;
+		threads[i].tid = i;
+		threads[i].ops = 0;
+
+		CPU_ZERO(&cpu);
+		CPU_SET(i % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&threads[i].thread, &thread_attr, workerfn,
+				     &threads[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	/* sleep() returns early on SIGINT, the runtime says how early */
+	gettimeofday(&start, NULL);
+	sleep(sb->nsecs);
+	scaling_done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+
+	for (i = 0; i < nr; i++) {
+		ret = pthread_join(threads[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	secs = runtime.tv_sec + runtime.tv_usec / 1e6;
+	if (secs <= 0)
+		return 0;
+
+	for (i = 0; i < nr; i++) {
+		unsigned long t = threads[i].ops / secs;
+
+		if (!sb->silent)
+			printf("  [thread %3d] %ld ops/sec\n", threads[i].tid, t);
+		total += t;
+	}
+	return total;
+}
+
+/*
+ * Run the steps of @sb and print the scaling table.  scaling_init() must
+ * have been called first.
+ */
+void scaling_run(struct scaling_bench *sb)
+{
+	struct scaling_thread *threads;
+	unsigned long base_ops = 0;
+	unsigned int nr, step, ncpus;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	threads = calloc(sb->nthreads, sizeof(*threads));
+	if (!threads)
+		err(EXIT_FAILURE, "calloc");
+
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	printf("%8s %16s %16s %10s\n", "threads", "ops/sec", "ops/sec/thread", "scaling");
+	for (nr = 1, step = 0; !interrupted; nr = min(nr * 2, sb->nthreads), step++) {
+		unsigned long ops;
+
+		if (sb->prepare)
+			sb->prepare(nr, step);
+		ops = run_step(sb, threads, nr, ncpus);
+
+		if (nr == 1)
+			base_ops = ops;
+		printf("%8d %16ld %16ld %9.2fx\n", nr, ops, ops / nr,
+		       base_ops ? (double)ops / base_ops : 0.0);
+		if (nr == sb->nthreads)
+			break;
+	}
+
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	free(threads);
+}
@@ -0,0 +1,28 @@
+#ifndef BENCH_SCALING_H
+#define BENCH_SCALING_H
+
+#include <stdbool.h>
+
+/*
+ * Harness for the benchmarks which run the same loop in 1, 2, 4, ... up
+ * to nthreads threads and print how the throughput scales.
+ */
+struct scaling_bench {
+	unsigned int	nthreads;	/* maximum, 0 for the number of CPUs */
+	unsigned int	nsecs;		/* runtime of each step */
+	bool		silent;		/* do not display per-thread data */
+	/*
+	 * Loop in thread @tid until scaling_done is set, counting the
+	 * operations done in @ops.
+	 */
+	void		(*work)(unsigned int tid, unsigned long *ops);
+	/* Optional, called before the @nr threads of each step start. */
+	void		(*prepare)(unsigned int nr, unsigned int step);
+};
+
+extern volatile bool scaling_done;
+
+void scaling_init(struct scaling_bench *sb);
+void scaling_run(struct scaling_bench *sb);
+
+#endif /* BENCH_SCALING_H */
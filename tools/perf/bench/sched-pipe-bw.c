@@ -0,0 +1,198 @@
+/*
+ * sched-pipe-bw.c
+ *
+ * pipe-bw: measure bulk throughput through a pipe()
+ *
+ * Where 'perf bench sched pipe' ping-pongs a single int between two tasks
+ * and so measures wakeup latency, this one keeps a writer streaming data
+ * into a pipe and a reader draining it, and reports bytes/sec for a range
+ * of write sizes.  Every full page written needs a fresh pipe buffer, so
+ * this is the case that stresses the buffer page allocation.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <pthread.h>
+
+static unsigned int wsize = 0;
+static unsigned int nsecs = 5;
+static unsigned int pipe_size = 0;
+static bool threaded;
+static bool done = false, interrupted = false;
+
+static const unsigned int default_sizes[] = { 64, 512, 4096, 16384, 65536, 262144 };
+
+static const struct option options[] = {
+	OPT_UINTEGER('s', "size",      &wsize,     "Specify write size in bytes (default: 64 bytes to 256k)"),
+	OPT_UINTEGER('r', "runtime",   &nsecs,     "Specify runtime of each step (in seconds)"),
+	OPT_UINTEGER('p', "pipe-size", &pipe_size, "Specify pipe size in bytes (F_SETPIPE_SZ)"),
+	OPT_BOOLEAN( 'T', "threaded",  &threaded,  "Specify threads/process based task setup"),
+	OPT_END()
+};
+
+static const char * const bench_sched_pipe_bw_usage[] = {
+	"perf bench sched pipe-bw <options>",
+	NULL
+};
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	done = true;
+}
+
+static void toggle_interrupted(int sig __maybe_unused,
+			       siginfo_t *info __maybe_unused,
+			       void *uc __maybe_unused)
+{
+	done = interrupted = true;
+}
+
+/* Drain the pipe until the writer goes away. */
+static void *reader(void *arg)
+{
+	int fd = (long) arg;
+	char *buf;
+	ssize_t ret;
+
+	buf = malloc(default_sizes[ARRAY_SIZE(default_sizes) - 1]);
+	if (!buf)
+		err(EXIT_FAILURE, "malloc");
+
+	do {
+		ret = read(fd, buf, default_sizes[ARRAY_SIZE(default_sizes) - 1]);
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+
+	free(buf);
+	return NULL;
+}
+
+static void run_step(unsigned int size)
+{
+	struct timeval start, end, runtime;
+	unsigned long long bytes = 0, writes = 0;
+	pthread_t thread;
+	pid_t pid = 0;
+	double secs;
+	int fds[2], wait_stat;
+	char *buf;
+
+	buf = malloc(size);
+	if (!buf)
+		err(EXIT_FAILURE, "malloc");
+	memset(buf, 0x5a, size);
+
+	if (pipe(fds))
+		err(EXIT_FAILURE, "pipe");
+	if (pipe_size && fcntl(fds[1], F_SETPIPE_SZ, pipe_size) < 0)
+		err(EXIT_FAILURE, "F_SETPIPE_SZ");
+
+	if (threaded) {
+		if (pthread_create(&thread, NULL, reader, (void *)(long) fds[0]))
+			err(EXIT_FAILURE, "pthread_create");
+	} else {
+		/* Don't let the child flush our buffered output again */
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0)
+			err(EXIT_FAILURE, "fork");
+		if (!pid) {
+			close(fds[1]);
+			reader((void *)(long) fds[0]);
+			exit(0);
+		}
+		close(fds[0]);
+	}
+
+	done = interrupted;
+	alarm(nsecs);
+	gettimeofday(&start, NULL);
+	while (!done) {
+		ssize_t ret = write(fds[1], buf, size);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "write");
+		}
+		bytes += ret;
+		writes++;
+	}
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+
+	close(fds[1]);
+	if (threaded) {
+		if (pthread_join(thread, NULL))
+			err(EXIT_FAILURE, "pthread_join");
+		close(fds[0]);
+	} else {
+		if (waitpid(pid, &wait_stat, 0) != pid || !WIFEXITED(wait_stat))
+			errx(EXIT_FAILURE, "reader did not exit cleanly");
+	}
+	free(buf);
+
+	secs = runtime.tv_sec + runtime.tv_usec / 1e6;
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("%10u %16.2f %16.0f\n", size,
+		       bytes / secs / (1024 * 1024), writes / secs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%u %.0f\n", size, bytes / secs);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+int bench_sched_pipe_bw(int argc, const char **argv,
+			const char *prefix __maybe_unused)
+{
+	struct sigaction act;
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options, bench_sched_pipe_bw_usage, 0);
+	if (argc) {
+		usage_with_options(bench_sched_pipe_bw_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!nsecs)
+		nsecs = 1;
+
+	sigfillset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGALRM, &act, NULL);
+	act.sa_sigaction = toggle_interrupted;
+	sigaction(SIGINT, &act, NULL);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# Streaming through a pipe between two %s, %d secs per step\n\n",
+		       threaded ? "threads" : "processes", nsecs);
+		printf("%10s %16s %16s\n", "size", "MB/sec", "writes/sec");
+	}
+
+	if (wsize)
+		run_step(wsize);
+	else
+		for (i = 0; i < ARRAY_SIZE(default_sizes) && !interrupted; i++)
+			run_step(default_sizes[i]);
+
+	return 0;
+}
@@ -10,9 +10,12 @@
  * Available benchmark collection list:
  *
  *  sched ... scheduler and IPC performance
- *  mem   ... memory access performance
+ *  mem   ... memory access performance (copies, shared memory faults)
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  fd    ... File descriptor table performance
+ *  epoll ... epoll event delivery performance
+ *  fs    ... Filesystem performance (inode cache, file locks, lookups)
  */
 #include "perf.h"
 #include "util/util.h"
@@ -44,6 +47,7 @@ static struct bench numa_benchmarks[] = {
 static struct bench sched_benchmarks[] = {
 	{ "messaging",	"Benchmark for scheduling and IPC",		bench_sched_messaging	},
 	{ "pipe",	"Benchmark for pipe() between two processes",	bench_sched_pipe	},
+	{ "pipe-bw",	"Benchmark for pipe() streaming throughput",	bench_sched_pipe_bw	},
 	{ "all",	"Test all scheduler benchmarks",		NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -51,6 +55,7 @@ static struct bench sched_benchmarks[] = {
 static struct bench mem_benchmarks[] = {
 	{ "memcpy",	"Benchmark for memcpy()",			bench_mem_memcpy	},
 	{ "memset",	"Benchmark for memset() tests",			bench_mem_memset	},
+	{ "shmem",	"Benchmark for shmem faults and TLB misses",	bench_mem_shmem		},
 	{ "all",	"Test all memory benchmarks",			NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -64,6 +69,27 @@ static struct bench futex_benchmarks[] = {
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench fd_benchmarks[] = {
+	{ "parallel",	"Benchmark for parallel fd open and close",	bench_fd_parallel	},
+	{ "all",	"Test all fd benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench epoll_benchmarks[] = {
+	{ "ready",	"Benchmark for draining epoll ready lists",	bench_epoll_ready	},
+	{ "all",	"Test all epoll benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench fs_benchmarks[] = {
+	{ "inode",		"Benchmark for inode cache scalability",	bench_fs_inode		},
+	{ "posix-locks",	"Benchmark for locks on a busy file",		bench_fs_posix_locks	},
+	{ "proc-lookup",	"Benchmark for path lookups in proc and sysfs",	bench_fs_proc_lookup	},
+	{ "lookup",		"Benchmark for lookups in one big directory",	bench_fs_lookup		},
+	{ "all",		"Test all fs benchmarks",			NULL			},
+	{ NULL,			NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -77,6 +103,9 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "fd",		"File descriptor table benchmarks",		fd_benchmarks		},
+	{ "epoll",	"epoll benchmarks",				epoll_benchmarks	},
+	{ "fs",		"Filesystem benchmarks",			fs_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -0,0 +1,196 @@
+/*
+ * aio_poll_fsync.c - functional test for IOCB_CMD_POLL and async fsync
+ *
+ * Arms IOCB_CMD_POLL on a pipe and checks that it only completes once the
+ * pipe becomes readable, that io_cancel() completes a pending poll, and
+ * that IOCB_CMD_FSYNC/IOCB_CMD_FDSYNC on a regular file complete through
+ * the same ring.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "../kselftest.h"
+
+#ifndef IOCB_CMD_POLL
+#define IOCB_CMD_POLL	5
+#endif
+
+static int io_setup(unsigned nr, aio_context_t *ctx)
+{
+	return syscall(__NR_io_setup, nr, ctx);
+}
+
+static int io_destroy(aio_context_t ctx)
+{
+	return syscall(__NR_io_destroy, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+	return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+static int io_cancel(aio_context_t ctx, struct iocb *iocb,
+		     struct io_event *result)
+{
+	return syscall(__NR_io_cancel, ctx, iocb, result);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long nr,
+			struct io_event *events, long timeout_ms)
+{
+	struct timespec ts = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000,
+	};
+
+	return syscall(__NR_io_getevents, ctx, min_nr, nr, events, &ts);
+}
+
+static int submit_one(aio_context_t ctx, struct iocb *iocb, int opcode,
+		      int fd, unsigned long buf)
+{
+	struct iocb *iocbs[1] = { iocb };
+
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_lio_opcode = opcode;
+	iocb->aio_fildes = fd;
+	iocb->aio_buf = buf;
+	iocb->aio_data = opcode;
+	return io_submit(ctx, 1, iocbs);
+}
+
+static int test_poll(aio_context_t ctx)
+{
+	struct io_event ev;
+	struct iocb iocb;
+	int fds[2], ret = 0;
+
+	if (pipe(fds)) {
+		perror("pipe");
+		return -1;
+	}
+
+	if (submit_one(ctx, &iocb, IOCB_CMD_POLL, fds[0], POLLIN) != 1) {
+		if (errno == EINVAL) {
+			printf("IOCB_CMD_POLL not supported, skipping\n");
+			ret = 1;
+		} else {
+			perror("io_submit(IOCB_CMD_POLL)");
+			ret = -1;
+		}
+		goto out;
+	}
+
+	if (io_getevents(ctx, 1, 1, &ev, 100) != 0) {
+		printf("poll completed on an empty pipe: [FAIL]\n");
+		ret = -1;
+		goto out;
+	}
+
+	if (write(fds[1], "x", 1) != 1) {
+		ret = -1;
+		goto out;
+	}
+	if (io_getevents(ctx, 1, 1, &ev, 1000) != 1 ||
+	    ev.obj != (unsigned long)&iocb || !(ev.res & POLLIN)) {
+		printf("poll did not complete with POLLIN: [FAIL]\n");
+		ret = -1;
+		goto out;
+	}
+	printf("poll wakeup: [PASS]\n");
+
+	/* the pipe is still readable, a new poll completes right away */
+	if (submit_one(ctx, &iocb, IOCB_CMD_POLL, fds[0], POLLIN) != 1 ||
+	    io_getevents(ctx, 1, 1, &ev, 1000) != 1 || !(ev.res & POLLIN)) {
+		printf("poll on a ready pipe did not complete: [FAIL]\n");
+		ret = -1;
+		goto out;
+	}
+	printf("poll ready: [PASS]\n");
+
+	/* nobody ever writes to it: cancel completes the request instead */
+	if (submit_one(ctx, &iocb, IOCB_CMD_POLL, fds[1], POLLIN) != 1 ||
+	    io_cancel(ctx, &iocb, &ev) != -1 || errno != EINPROGRESS ||
+	    io_getevents(ctx, 1, 1, &ev, 1000) != 1 || ev.res != 0) {
+		printf("poll cancel: [FAIL]\n");
+		ret = -1;
+		goto out;
+	}
+	printf("poll cancel: [PASS]\n");
+out:
+	close(fds[0]);
+	close(fds[1]);
+	return ret;
+}
+
+static int test_fsync(aio_context_t ctx, int opcode)
+{
+	char path[] = "/tmp/aio_fsync_XXXXXX";
+	struct io_event ev;
+	struct iocb iocb;
+	int fd, ret = 0;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return -1;
+	}
+	unlink(path);
+
+	if (write(fd, "data", 4) != 4) {
+		ret = -1;
+		goto out;
+	}
+
+	if (submit_one(ctx, &iocb, opcode, fd, 0) != 1 ||
+	    io_getevents(ctx, 1, 1, &ev, 5000) != 1 ||
+	    ev.data != (unsigned)opcode || ev.res != 0) {
+		printf("%s: [FAIL]\n", opcode == IOCB_CMD_FSYNC ?
+		       "fsync" : "fdatasync");
+		ret = -1;
+		goto out;
+	}
+	printf("%s: [PASS]\n", opcode == IOCB_CMD_FSYNC ?
+	       "fsync" : "fdatasync");
+out:
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	aio_context_t ctx = 0;
+	int ret;
+
+	if (io_setup(16, &ctx)) {
+		if (errno == ENOSYS) {
+			printf("AIO not supported, skipping\n");
+			return ksft_exit_skip();
+		}
+		perror("io_setup");
+		return ksft_exit_fail();
+	}
+
+	ret = test_poll(ctx);
+	if (ret > 0) {
+		io_destroy(ctx);
+		return ksft_exit_skip();
+	}
+	ret |= test_fsync(ctx, IOCB_CMD_FSYNC);
+	ret |= test_fsync(ctx, IOCB_CMD_FDSYNC);
+
+	io_destroy(ctx);
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
@@ -0,0 +1,179 @@
+/*
+ * aio_sqring.c - functional test for the AIO submission ring
+ *
+ * Registers a file and a buffer with io_register(), queues reads through
+ * the submission ring and consumes it with io_submit(ctx, 0, NULL).  Checks
+ * the data that was read, that an iocb failing submission is completed
+ * with its error, and that ring head follows tail.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "../kselftest.h"
+
+#define RING_ENTRIES	8
+#define BUF_SIZE	(64 * 1024)
+
+#ifndef IOCB_FLAG_FIXEDBUF
+#define IOCB_FLAG_FIXEDBUF	(1 << 1)
+#define IOCB_FLAG_FIXEDFILE	(1 << 2)
+
+#define AIO_REGISTER_SQRING	0
+#define AIO_REGISTER_BUFFERS	1
+#define AIO_REGISTER_FILES	2
+
+struct aio_sqring_setup {
+	__u64	ring;
+	__u32	entries;
+	__u32	flags;
+	__u32	idle_ms;
+	__u32	resv[3];
+};
+
+struct aio_sqring {
+	__u32		head;
+	__u32		tail;
+	__u32		flags;
+	__u32		resv;
+	struct iocb	iocbs[0];
+};
+#endif
+
+static int io_register(aio_context_t ctx, unsigned int opcode, void *arg,
+		       unsigned int nr_args)
+{
+#ifdef __NR_io_register
+	return syscall(__NR_io_register, ctx, opcode, arg, nr_args);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void queue_read(struct aio_sqring *ring, unsigned int file_idx,
+		       char *buf, size_t len, off_t off, __u64 data)
+{
+	struct iocb *iocb = &ring->iocbs[ring->tail & (RING_ENTRIES - 1)];
+
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_lio_opcode = IOCB_CMD_PREAD;
+	iocb->aio_flags = IOCB_FLAG_FIXEDBUF | IOCB_FLAG_FIXEDFILE;
+	iocb->aio_fildes = file_idx;
+	iocb->aio_buf = (unsigned long)buf;
+	iocb->aio_nbytes = len;
+	iocb->aio_offset = off;
+	iocb->aio_reserved2 = 0;	/* registered buffer index */
+	iocb->aio_data = data;
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/aio_sqring_XXXXXX";
+	struct aio_sqring_setup setup;
+	struct aio_sqring *ring;
+	struct io_event ev[RING_ENTRIES];
+	struct timespec ts = { .tv_sec = 5 };
+	aio_context_t ctx = 0;
+	struct iovec iov;
+	char *buf, data[4096];
+	int fd, i, n, ret = 0;
+
+	if (syscall(__NR_io_setup, 16, &ctx)) {
+		perror("io_setup");
+		return ksft_exit_skip();
+	}
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return ksft_exit_fail();
+	}
+	unlink(path);
+	for (i = 0; i < (int)sizeof(data); i++)
+		data[i] = i * 7;
+	if (pwrite(fd, data, sizeof(data), 0) != sizeof(data))
+		return ksft_exit_fail();
+
+	if (posix_memalign((void **)&buf, 4096, BUF_SIZE) ||
+	    posix_memalign((void **)&ring, 4096, sizeof(*ring) +
+			   RING_ENTRIES * sizeof(struct iocb)))
+		return ksft_exit_fail();
+	memset(buf, 0, BUF_SIZE);
+	memset(ring, 0, sizeof(*ring));
+
+	if (io_register(ctx, AIO_REGISTER_FILES, &fd, 1)) {
+		if (errno == ENOSYS) {
+			printf("io_register() not supported, skipping\n");
+			return ksft_exit_skip();
+		}
+		perror("AIO_REGISTER_FILES");
+		return ksft_exit_fail();
+	}
+	iov.iov_base = buf;
+	iov.iov_len = BUF_SIZE;
+	if (io_register(ctx, AIO_REGISTER_BUFFERS, &iov, 1)) {
+		perror("AIO_REGISTER_BUFFERS");
+		return ksft_exit_fail();
+	}
+	memset(&setup, 0, sizeof(setup));
+	setup.ring = (unsigned long)ring;
+	setup.entries = RING_ENTRIES;
+	if (io_register(ctx, AIO_REGISTER_SQRING, &setup, 1)) {
+		perror("AIO_REGISTER_SQRING");
+		return ksft_exit_fail();
+	}
+	if (io_register(ctx, AIO_REGISTER_FILES, &fd, 1) != -1 ||
+	    errno != EBUSY) {
+		printf("second file registration: [FAIL]\n");
+		ret = -1;
+	}
+
+	/* two good reads at different places of the buffer, one bad file */
+	queue_read(ring, 0, buf, 1024, 0, 1);
+	queue_read(ring, 0, buf + 8192 + 100, 2048, 1024, 2);
+	queue_read(ring, 3, buf, 1024, 0, 3);
+
+	n = syscall(__NR_io_submit, ctx, 0, NULL);
+	if (n != 3 || ring->head != ring->tail) {
+		printf("io_submit(ctx, 0) consumed %d, head %u tail %u: [FAIL]\n",
+		       n, ring->head, ring->tail);
+		return ksft_exit_fail();
+	}
+
+	n = syscall(__NR_io_getevents, ctx, 3, RING_ENTRIES, ev, &ts);
+	if (n != 3) {
+		printf("io_getevents() returned %d: [FAIL]\n", n);
+		return ksft_exit_fail();
+	}
+	for (i = 0; i < n; i++) {
+		long expect = ev[i].data == 1 ? 1024 :
+			      ev[i].data == 2 ? 2048 : -EBADF;
+
+		if (ev[i].res != expect) {
+			printf("iocb %llu: res %lld, expected %ld: [FAIL]\n",
+			       (unsigned long long)ev[i].data,
+			       (long long)ev[i].res, expect);
+			ret = -1;
+		}
+	}
+	if (memcmp(buf, data, 1024) ||
+	    memcmp(buf + 8192 + 100, data + 1024, 2048)) {
+		printf("data read through the registered buffer: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("submission ring reads: [PASS]\n");
+	}
+
+	syscall(__NR_io_destroy, ctx);
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
@@ -0,0 +1,144 @@
+/*
+ * copy_file_range.c - functional test for copy_file_range()
+ *
+ * Copies a file with and without explicit offsets and checks the data,
+ * the returned length at EOF, the file position updates and the error
+ * cases (overlapping ranges in one file, read-only destination).
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+#include "../kselftest.h"
+
+#define SIZE	(1024 * 1024 + 123)
+
+static loff_t cfr(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+		  size_t len, unsigned int flags)
+{
+#ifdef __NR_copy_file_range
+	return syscall(__NR_copy_file_range, fd_in, off_in, fd_out, off_out,
+		       len, flags);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int check_data(int fd, const char *expect, off_t off, size_t len)
+{
+	char *buf = malloc(len);
+	int ret;
+
+	if (!buf || pread(fd, buf, len, off) != (ssize_t) len)
+		return -1;
+	ret = memcmp(buf, expect, len) ? -1 : 0;
+	free(buf);
+	return ret;
+}
+
+int main(void)
+{
+	char src_name[] = "/tmp/cfr_srcXXXXXX", dst_name[] = "/tmp/cfr_dstXXXXXX";
+	loff_t off_in, off_out;
+	int src, dst, ro, i, ret = 0;
+	char *data;
+	ssize_t n;
+
+	data = malloc(SIZE);
+	src = mkstemp(src_name);
+	dst = mkstemp(dst_name);
+	if (!data || src < 0 || dst < 0) {
+		perror("setup");
+		return ksft_exit_fail();
+	}
+	unlink(src_name);
+	for (i = 0; i < SIZE; i++)
+		data[i] = i * 7 + (i >> 12);
+	if (write(src, data, SIZE) != SIZE) {
+		perror("write");
+		return ksft_exit_fail();
+	}
+
+	/* whole file, using and updating the file positions */
+	lseek(src, 0, SEEK_SET);
+	n = cfr(src, NULL, dst, NULL, SIZE, 0);
+	if (n < 0 && errno == ENOSYS) {
+		printf("copy_file_range() not supported, skipping\n");
+		unlink(dst_name);
+		return ksft_exit_skip();
+	}
+	while (n > 0 && lseek(dst, 0, SEEK_CUR) < SIZE) {
+		ssize_t more = cfr(src, NULL, dst, NULL, SIZE, 0);
+
+		if (more <= 0)
+			break;
+		n += more;
+	}
+	if (n != SIZE || lseek(src, 0, SEEK_CUR) != SIZE ||
+	    lseek(dst, 0, SEEK_CUR) != SIZE || check_data(dst, data, 0, SIZE)) {
+		printf("whole file copy: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("whole file copy: [PASS]\n");
+	}
+
+	/* explicit offsets, short copy at EOF, positions untouched */
+	off_in = SIZE - 1000;
+	off_out = 4096 + 17;
+	n = cfr(src, &off_in, dst, &off_out, 5000, 0);
+	if (n != 1000 || off_in != SIZE || off_out != 4096 + 17 + 1000 ||
+	    lseek(src, 0, SEEK_CUR) != SIZE ||
+	    check_data(dst, data + SIZE - 1000, 4096 + 17, 1000)) {
+		printf("offset copy: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("offset copy: [PASS]\n");
+	}
+
+	/* nothing to copy past EOF */
+	off_in = SIZE + 10;
+	off_out = 0;
+	if (cfr(src, &off_in, dst, &off_out, 100, 0) != 0) {
+		printf("copy past EOF: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("copy past EOF: [PASS]\n");
+	}
+
+	/* overlapping ranges in the same file */
+	off_in = 0;
+	off_out = 4096;
+	if (cfr(dst, &off_in, dst, &off_out, 8192, 0) != -1 || errno != EINVAL) {
+		printf("overlapping copy: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("overlapping copy: [PASS]\n");
+	}
+
+	/* destination must be writable, flags must be zero */
+	ro = open(dst_name, O_RDONLY);
+	off_in = 0;
+	if (ro < 0 || cfr(src, &off_in, ro, NULL, 100, 0) != -1 ||
+	    errno != EBADF ||
+	    cfr(src, &off_in, dst, NULL, 100, 1) != -1 || errno != EINVAL) {
+		printf("bad arguments: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("bad arguments: [PASS]\n");
+	}
+
+	close(ro);
+	close(src);
+	close(dst);
+	unlink(dst_name);
+	free(data);
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
@@ -0,0 +1,155 @@
+/*
+ * epoll_ctl_batch.c - functional test for epoll_ctl_batch()
+ *
+ * Adds, re-arms and removes a set of pipes through one epoll_ctl_batch()
+ * call each and checks the per-command results, including the failures
+ * (bad fd, unknown op, duplicate add) that must not abort the batch.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <linux/types.h>
+
+#include "../kselftest.h"
+
+#define NR_PIPES	16
+
+struct epoll_ctl_cmd {
+	__u32 flags;
+	__s32 op;
+	__s32 fd;
+	__u32 events;
+	__u64 data;
+	__s32 result;
+	__u32 __pad;
+};
+
+static int sys_epoll_ctl_batch(int epfd, int flags, int ncmds,
+			       struct epoll_ctl_cmd *cmds)
+{
+#ifdef __NR_epoll_ctl_batch
+	return syscall(__NR_epoll_ctl_batch, epfd, flags, ncmds, cmds);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int check(struct epoll_ctl_cmd *cmds, int n, const int *expect,
+		 const char *what)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < n; i++) {
+		if (cmds[i].result != expect[i]) {
+			printf("%s: cmd %d returned %d, expected %d\n",
+			       what, i, cmds[i].result, expect[i]);
+			ret = -1;
+		}
+	}
+	printf("%s: [%s]\n", what, ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_ctl_cmd cmds[NR_PIPES + 3];
+	int expect[NR_PIPES + 3];
+	struct epoll_event ev[NR_PIPES];
+	int pipes[NR_PIPES][2];
+	int epfd, i, n, ret = 0;
+
+	epfd = epoll_create1(0);
+	for (i = 0; i < NR_PIPES; i++) {
+		if (pipe(pipes[i])) {
+			perror("pipe");
+			return ksft_exit_fail();
+		}
+	}
+
+	/* add every read end, plus three commands that must fail */
+	memset(cmds, 0, sizeof(cmds));
+	for (i = 0; i < NR_PIPES; i++) {
+		cmds[i].op = EPOLL_CTL_ADD;
+		cmds[i].fd = pipes[i][0];
+		cmds[i].events = EPOLLIN | EPOLLONESHOT;
+		cmds[i].data = i;
+		expect[i] = 0;
+	}
+	cmds[i].op = EPOLL_CTL_ADD;
+	cmds[i].fd = pipes[0][0];
+	cmds[i].events = EPOLLIN;
+	expect[i++] = -EEXIST;
+	cmds[i].op = EPOLL_CTL_ADD;
+	cmds[i].fd = -1;
+	expect[i++] = -EBADF;
+	cmds[i].op = 42;
+	cmds[i].fd = pipes[1][0];
+	expect[i++] = -EINVAL;
+
+	n = sys_epoll_ctl_batch(epfd, 0, i, cmds);
+	if (n < 0 && errno == ENOSYS) {
+		printf("epoll_ctl_batch() not supported, skipping\n");
+		return ksft_exit_skip();
+	}
+	if (n != i) {
+		printf("epoll_ctl_batch() returned %d, expected %d\n", n, i);
+		return ksft_exit_fail();
+	}
+	ret |= check(cmds, i, expect, "batched add");
+
+	/* fire every pipe once; EPOLLONESHOT disarms them */
+	for (i = 0; i < NR_PIPES; i++)
+		if (write(pipes[i][1], "x", 1) != 1)
+			return ksft_exit_fail();
+	n = epoll_wait(epfd, ev, NR_PIPES, 1000);
+	if (n != NR_PIPES) {
+		printf("first epoll_wait() returned %d, expected %d\n",
+		       n, NR_PIPES);
+		ret = -1;
+	}
+	if (epoll_wait(epfd, ev, NR_PIPES, 0) != 0) {
+		printf("oneshot descriptors did not disarm: [FAIL]\n");
+		ret = -1;
+	}
+
+	/* re-arm them all in one go; the data is still pending */
+	for (i = 0; i < NR_PIPES; i++) {
+		cmds[i].op = EPOLL_CTL_MOD;
+		cmds[i].result = 1;
+		expect[i] = 0;
+	}
+	if (sys_epoll_ctl_batch(epfd, 0, NR_PIPES, cmds) != NR_PIPES)
+		return ksft_exit_fail();
+	ret |= check(cmds, NR_PIPES, expect, "batched re-arm");
+	n = epoll_wait(epfd, ev, NR_PIPES, 1000);
+	if (n != NR_PIPES) {
+		printf("epoll_wait() after re-arm returned %d, expected %d\n",
+		       n, NR_PIPES);
+		ret = -1;
+	}
+
+	/* and remove them */
+	for (i = 0; i < NR_PIPES; i++)
+		cmds[i].op = EPOLL_CTL_DEL;
+	if (sys_epoll_ctl_batch(epfd, 0, NR_PIPES, cmds) != NR_PIPES)
+		return ksft_exit_fail();
+	ret |= check(cmds, NR_PIPES, expect, "batched delete");
+
+	/* bad flags are rejected as a whole */
+	if (sys_epoll_ctl_batch(epfd, 1, NR_PIPES, cmds) != -1 ||
+	    errno != EINVAL) {
+		printf("non-zero flags accepted: [FAIL]\n");
+		ret = -1;
+	}
+
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
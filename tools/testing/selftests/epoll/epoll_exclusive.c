@@ -0,0 +1,173 @@
+/*
+ * epoll_exclusive.c - check EPOLLEXCLUSIVE and EPOLLROUNDROBIN wakeups
+ *
+ * Several threads, each with a private epoll instance, watch the same
+ * eventfd edge-triggered.  Every write is a new edge, so without
+ * EPOLLEXCLUSIVE each write is reported by every instance.  With
+ * EPOLLEXCLUSIVE a write must be reported by only one of them, and adding
+ * EPOLLROUNDROBIN must spread successive writes over more than one
+ * instance.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../kselftest.h"
+
+#ifndef EPOLLROUNDROBIN
+#define EPOLLROUNDROBIN (1 << 27)
+#endif
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1 << 28)
+#endif
+
+#define NR_WAITERS	8
+#define NR_EVENTS	64
+
+static int efd;
+static volatile int stop;
+static int wakeups[NR_WAITERS];
+
+struct waiter {
+	int id;
+	int epfd;
+	pthread_t thread;
+};
+
+static void *waiter_fn(void *arg)
+{
+	struct waiter *w = arg;
+	struct epoll_event ev;
+
+	while (!stop) {
+		if (epoll_wait(w->epfd, &ev, 1, 100) != 1)
+			continue;
+		__sync_fetch_and_add(&wakeups[w->id], 1);
+	}
+	return NULL;
+}
+
+static int total_wakeups(void)
+{
+	int i, n = 0;
+
+	for (i = 0; i < NR_WAITERS; i++)
+		n += __sync_fetch_and_add(&wakeups[i], 0);
+	return n;
+}
+
+static int busy_waiters(void)
+{
+	int i, n = 0;
+
+	for (i = 0; i < NR_WAITERS; i++)
+		n += !!wakeups[i];
+	return n;
+}
+
+static int run(unsigned int events, int nr_writes, int *total, int *busy)
+{
+	struct waiter w[NR_WAITERS];
+	struct epoll_event ev = { .events = events | EPOLLIN | EPOLLET };
+	uint64_t one = 1;
+	int i;
+
+	efd = eventfd(0, EFD_NONBLOCK);
+	if (efd < 0) {
+		perror("eventfd");
+		return -1;
+	}
+
+	stop = 0;
+	for (i = 0; i < NR_WAITERS; i++) {
+		wakeups[i] = 0;
+		w[i].id = i;
+		w[i].epfd = epoll_create1(0);
+		if (w[i].epfd < 0 ||
+		    epoll_ctl(w[i].epfd, EPOLL_CTL_ADD, efd, &ev)) {
+			perror("epoll_ctl");
+			return -1;
+		}
+		pthread_create(&w[i].thread, NULL, waiter_fn, &w[i]);
+	}
+
+	/* let everybody go to sleep in epoll_wait() */
+	usleep(200000);
+
+	for (i = 0; i < nr_writes; i++) {
+		if (write(efd, &one, sizeof(one)) != sizeof(one)) {
+			perror("write");
+			return -1;
+		}
+		usleep(20000);
+	}
+
+	*total = total_wakeups();
+	*busy = busy_waiters();
+
+	stop = 1;
+	for (i = 0; i < NR_WAITERS; i++) {
+		pthread_join(w[i].thread, NULL);
+		close(w[i].epfd);
+	}
+	close(efd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE };
+	int total, busy, ret = 0;
+	int epfd;
+
+	/* EPOLLEXCLUSIVE may not be changed by EPOLL_CTL_MOD */
+	epfd = epoll_create1(0);
+	efd = eventfd(0, 0);
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev)) {
+		if (errno == EINVAL) {
+			printf("EPOLLEXCLUSIVE not supported, skipping\n");
+			return ksft_exit_skip();
+		}
+		perror("epoll_ctl");
+		return ksft_exit_fail();
+	}
+	ev.events = EPOLLIN;
+	if (!epoll_ctl(epfd, EPOLL_CTL_MOD, efd, &ev) || errno != EINVAL) {
+		printf("EPOLL_CTL_MOD of an exclusive entry: [FAIL]\n");
+		ret = 1;
+	}
+	close(efd);
+	close(epfd);
+
+	if (run(0, 1, &total, &busy))
+		return ksft_exit_fail();
+	printf("shared:      1 event woke %d of %d waiters\n", total, NR_WAITERS);
+
+	if (run(EPOLLEXCLUSIVE, 1, &total, &busy))
+		return ksft_exit_fail();
+	printf("exclusive:   1 event woke %d of %d waiters\n", total, NR_WAITERS);
+	if (total != 1) {
+		printf("exclusive wakeup: [FAIL]\n");
+		ret = 1;
+	}
+
+	if (run(EPOLLEXCLUSIVE | EPOLLROUNDROBIN, NR_EVENTS,
+		&total, &busy))
+		return ksft_exit_fail();
+	printf("round-robin: %d events spread over %d of %d waiters\n",
+	       total, busy, NR_WAITERS);
+	if (busy < 2) {
+		printf("round-robin wakeup: [FAIL]\n");
+		ret = 1;
+	}
+
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
@@ -0,0 +1,142 @@
+/*
+ * fd_alloc_perf.c - measure lowest-free-fd allocation cost at high fd counts
+ *
+ * Fills the descriptor table with N open descriptors, then repeatedly
+ * closes one of them and dup()s it back.  POSIX requires dup() to return
+ * the lowest free descriptor, so every iteration exercises the free-fd
+ * search in __alloc_fd() against a nearly full table.  Both the cost of
+ * the close/dup pair and the correctness of the returned descriptor are
+ * checked.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../kselftest.h"
+
+#define NR_OPEN_PATH	"/proc/sys/fs/nr_open"
+#define LOOPS		200000
+
+static const int fd_counts[] = { 1000, 10000, 100000, 500000, 1000000 };
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long read_nr_open(void)
+{
+	FILE *f = fopen(NR_OPEN_PATH, "r");
+	long val = 0;
+
+	if (!f)
+		return 0;
+	if (fscanf(f, "%ld", &val) != 1)
+		val = 0;
+	fclose(f);
+	return val;
+}
+
+/* Raise RLIMIT_NOFILE as far as we are allowed; returns the new limit. */
+static long raise_nofile(long want)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl))
+		return -1;
+	if (rl.rlim_max != RLIM_INFINITY && (long)rl.rlim_max < want) {
+		rl.rlim_max = want;
+		if (setrlimit(RLIMIT_NOFILE, &rl))
+			getrlimit(RLIMIT_NOFILE, &rl);
+	}
+	rl.rlim_cur = rl.rlim_max;
+	if ((long)rl.rlim_cur > want)
+		rl.rlim_cur = want;
+	if (setrlimit(RLIMIT_NOFILE, &rl))
+		return -1;
+	return rl.rlim_cur;
+}
+
+static int run_one(int base, int nr)
+{
+	unsigned long long start, elapsed;
+	int i, fd, victim;
+
+	for (i = 0; i < nr; i++) {
+		fd = dup(base);
+		if (fd < 0) {
+			printf("dup() failed after %d fds: %s\n", i, strerror(errno));
+			return -1;
+		}
+	}
+
+	/*
+	 * Alternate the victim between the bottom and the top of the table,
+	 * the bottom being the case every accept()-heavy server hits and the
+	 * top being the one that used to scan the whole bitmap.
+	 */
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		victim = (i & 1) ? base + nr : base + 1 + (i % 64);
+		close(victim);
+		fd = dup(base);
+		if (fd != victim) {
+			printf("dup() returned %d, expected lowest free fd %d\n",
+			       fd, victim);
+			return -1;
+		}
+	}
+	elapsed = now_ns() - start;
+
+	printf("%8d fds: %8llu ns/op (close+dup)\n", nr,
+	       elapsed / LOOPS);
+
+	for (i = base + 1; i <= base + nr; i++)
+		close(i);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long limit, nr_open;
+	unsigned int i;
+	int base;
+
+	nr_open = read_nr_open();
+	if (nr_open <= 0)
+		nr_open = 1024 * 1024;
+	limit = raise_nofile(nr_open);
+	if (limit < 0) {
+		perror("setrlimit");
+		return ksft_exit_fail();
+	}
+
+	base = open("/dev/null", O_RDONLY);
+	if (base < 0) {
+		perror("open /dev/null");
+		return ksft_exit_fail();
+	}
+
+	for (i = 0; i < sizeof(fd_counts) / sizeof(fd_counts[0]); i++) {
+		if (base + fd_counts[i] + 1 >= limit) {
+			printf("%8d fds: skipped, RLIMIT_NOFILE is %ld\n",
+			       fd_counts[i], limit);
+			continue;
+		}
+		if (run_one(base, fd_counts[i]))
+			return ksft_exit_fail();
+	}
+
+	return ksft_exit_pass();
+}
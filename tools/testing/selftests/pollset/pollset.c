@@ -0,0 +1,178 @@
+/*
+ * pollset.c - functional test for pollset_create() and pollset_poll()
+ *
+ * Runs pollset_poll() and poll() side by side on the same descriptor
+ * array while pipes become readable and drained, entries change their
+ * fd or events, get disabled with a negative fd or are closed, and checks
+ * that both report the same thing.  Also checks that a set cannot contain
+ * itself, and that a blocking call is woken up by a write from another
+ * process.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "../kselftest.h"
+
+#define NPIPES	64
+
+static int pipes[NPIPES][2];
+static struct pollfd fds[NPIPES];
+static int psfd, ret;
+
+static int pollset_create(int flags)
+{
+#ifdef __NR_pollset_create
+	return syscall(__NR_pollset_create, flags);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int pollset_poll(int fd, struct pollfd *ufds, unsigned int nfds,
+			int timeout)
+{
+#ifdef __NR_pollset_poll
+	return syscall(__NR_pollset_poll, fd, ufds, nfds, timeout);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/* Compare pollset_poll() with poll() on the current array. */
+static void check(const char *what, int expect)
+{
+	struct pollfd ref[NPIPES];
+	int n, nref, i;
+
+	memcpy(ref, fds, sizeof(fds));
+	nref = poll(ref, NPIPES, 0);
+	n = pollset_poll(psfd, fds, NPIPES, 0);
+
+	for (i = 0; i < NPIPES; i++)
+		if (fds[i].revents != ref[i].revents)
+			break;
+	if (n != nref || n != expect || i < NPIPES) {
+		printf("%s: got %d, poll() %d, expected %d: [FAIL]\n",
+		       what, n, nref, expect);
+		ret = -1;
+	} else {
+		printf("%s: [PASS]\n", what);
+	}
+}
+
+int main(void)
+{
+	char c = 'x';
+	pid_t pid;
+	int i, n;
+
+	psfd = pollset_create(0);
+	if (psfd < 0 && errno == ENOSYS) {
+		printf("pollset_create() not supported, skipping\n");
+		return ksft_exit_skip();
+	}
+	if (psfd < 0) {
+		perror("pollset_create");
+		return ksft_exit_fail();
+	}
+
+	for (i = 0; i < NPIPES; i++) {
+		if (pipe(pipes[i])) {
+			perror("pipe");
+			return ksft_exit_fail();
+		}
+		fds[i].fd = pipes[i][0];
+		fds[i].events = POLLIN;
+	}
+
+	check("nothing ready", 0);
+
+	if (write(pipes[3][1], &c, 1) != 1 || write(pipes[17][1], &c, 1) != 1)
+		return ksft_exit_fail();
+	check("two pipes written", 2);
+	check("still ready (level triggered)", 2);
+
+	if (read(pipes[3][0], &c, 1) != 1)
+		return ksft_exit_fail();
+	check("one pipe drained", 1);
+
+	fds[5].fd = pipes[5][1];
+	fds[5].events = POLLOUT;
+	check("entry switched to a writable fd", 2);
+
+	fds[5].events = POLLIN;
+	check("events changed", 1);
+
+	fds[17].fd = -1;
+	check("entry disabled", 0);
+
+	close(pipes[20][0]);
+	check("fd closed", 1);
+	fds[20].fd = -1;
+	check("closed fd disabled", 0);
+
+	/* A set cannot contain itself */
+	fds[20].fd = psfd;
+	n = pollset_poll(psfd, fds, NPIPES, 0);
+	if (n != 1 || fds[20].revents != POLLNVAL) {
+		printf("set in itself: got %d: [FAIL]\n", n);
+		ret = -1;
+	} else {
+		printf("set in itself: [PASS]\n");
+	}
+	fds[20].fd = -1;
+
+	/* Block until another process writes */
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return ksft_exit_fail();
+	}
+	if (!pid) {
+		usleep(100000);
+		if (write(pipes[40][1], &c, 1) != 1)
+			exit(1);
+		exit(0);
+	}
+	n = pollset_poll(psfd, fds, NPIPES, 5000);
+	waitpid(pid, NULL, 0);
+	if (n != 1 || fds[40].revents != POLLIN) {
+		printf("blocking wait: got %d: [FAIL]\n", n);
+		ret = -1;
+	} else {
+		printf("blocking wait: [PASS]\n");
+	}
+	if (read(pipes[40][0], &c, 1) != 1)
+		return ksft_exit_fail();
+
+	n = pollset_poll(psfd, fds, NPIPES, 50);
+	if (n != 0) {
+		printf("timeout: got %d: [FAIL]\n", n);
+		ret = -1;
+	} else {
+		printf("timeout: [PASS]\n");
+	}
+
+	/* A smaller array drops the entries past its end */
+	n = pollset_poll(psfd, fds, 4, 0);
+	if (n != 0) {
+		printf("shrunk array: got %d: [FAIL]\n", n);
+		ret = -1;
+	} else {
+		printf("shrunk array: [PASS]\n");
+	}
+
+	close(psfd);
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
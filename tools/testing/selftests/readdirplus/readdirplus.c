@@ -0,0 +1,184 @@
+/*
+ * readdirplus.c - functional test for readdirplus()
+ *
+ * Fills a directory with files, a subdirectory and a symlink, reads it
+ * back with readdirplus() through a small buffer and checks that every
+ * name shows up exactly once with the attributes fstatat() reports for
+ * it.  Also checks the name-only (mask 0) record layout and the error
+ * cases.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/readdirplus.h>
+
+#include "../kselftest.h"
+
+#define NFILES	200
+
+static int rdp(int fd, void *buf, unsigned int count, unsigned int mask)
+{
+#ifdef __NR_readdirplus
+	return syscall(__NR_readdirplus, fd, buf, count, mask);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int check_entry(int dirfd, struct linux_dirent_plus *de)
+{
+	struct rdp_stat *st = (struct rdp_stat *)(de + 1);
+	const char *name = (char *)de + de->d_name_off;
+	struct stat sb;
+
+	if (fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW)) {
+		printf("%s: fstatat: %s\n", name, strerror(errno));
+		return -1;
+	}
+	if (de->d_error || de->d_mask != RDP_ALL) {
+		printf("%s: error %d, mask %x\n", name, de->d_error, de->d_mask);
+		return -1;
+	}
+	if (st->st_mode != sb.st_mode || st->st_nlink != sb.st_nlink ||
+	    st->st_uid != sb.st_uid || st->st_gid != sb.st_gid ||
+	    st->st_ino != sb.st_ino || st->st_size != (__u64) sb.st_size ||
+	    st->st_blocks != (__u64) sb.st_blocks ||
+	    st->st_mtim.tv_sec != sb.st_mtim.tv_sec ||
+	    st->st_mtim.tv_nsec != sb.st_mtim.tv_nsec) {
+		printf("%s: attributes differ from fstatat()\n", name);
+		return -1;
+	}
+	if (strcmp(name, ".") && strcmp(name, "..") && de->d_ino != sb.st_ino) {
+		printf("%s: d_ino %llu, st_ino %llu\n", name,
+		       (unsigned long long) de->d_ino,
+		       (unsigned long long) sb.st_ino);
+		return -1;
+	}
+	return 0;
+}
+
+/* Read @dirfd in small chunks, returns the number of entries or -1. */
+static int read_dir(int dirfd, unsigned int mask, char *seen)
+{
+	char buf[1024];
+	int n, nr = 0;
+
+	lseek(dirfd, 0, SEEK_SET);
+	while ((n = rdp(dirfd, buf, sizeof(buf), mask)) > 0) {
+		int pos = 0;
+
+		while (pos < n) {
+			struct linux_dirent_plus *de = (void *)(buf + pos);
+			const char *name = buf + pos + de->d_name_off;
+			int i;
+
+			if (de->d_name_off != sizeof(*de) +
+			    (mask ? sizeof(struct rdp_stat) : 0)) {
+				printf("bad d_name_off %u\n", de->d_name_off);
+				return -1;
+			}
+			if (mask && check_entry(dirfd, de))
+				return -1;
+			if (sscanf(name, "f%d", &i) == 1 && i >= 0 && i < NFILES)
+				seen[i]++;
+			pos += de->d_reclen;
+			nr++;
+		}
+	}
+	return n < 0 ? -1 : nr;
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/rdpXXXXXX", seen[NFILES], name[32];
+	int dirfd, fd, i, nr, ret = 0;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return ksft_exit_fail();
+	}
+	dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0) {
+		perror("open");
+		return ksft_exit_fail();
+	}
+
+	if (rdp(dirfd, seen, sizeof(seen), 0) < 0 && errno == ENOSYS) {
+		printf("readdirplus() not supported, skipping\n");
+		rmdir(dir);
+		return ksft_exit_skip();
+	}
+
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		fd = openat(dirfd, name, O_CREAT | O_WRONLY, 0600 | (i & 0111));
+		if (fd < 0 || ftruncate(fd, i * 100)) {
+			perror("create");
+			return ksft_exit_fail();
+		}
+		close(fd);
+	}
+	if (mkdirat(dirfd, "sub", 0700) || symlinkat("f0", dirfd, "link")) {
+		perror("mkdirat/symlinkat");
+		return ksft_exit_fail();
+	}
+
+	/* names and all attributes */
+	memset(seen, 0, sizeof(seen));
+	nr = read_dir(dirfd, RDP_ALL, seen);
+	for (i = 0; i < NFILES; i++)
+		if (seen[i] != 1)
+			nr = -1;
+	if (nr != NFILES + 4) {
+		printf("readdirplus with attributes: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("readdirplus with attributes: [PASS]\n");
+	}
+
+	/* names only */
+	memset(seen, 0, sizeof(seen));
+	nr = read_dir(dirfd, 0, seen);
+	for (i = 0; i < NFILES; i++)
+		if (seen[i] != 1)
+			nr = -1;
+	if (nr != NFILES + 4) {
+		printf("readdirplus names only: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("readdirplus names only: [PASS]\n");
+	}
+
+	/* unknown mask bits, buffer too small for one entry, not a dir */
+	lseek(dirfd, 0, SEEK_SET);
+	fd = openat(dirfd, "f1", O_RDONLY);
+	if (rdp(dirfd, seen, sizeof(seen), ~RDP_ALL) != -1 || errno != EINVAL ||
+	    rdp(dirfd, seen, 8, RDP_ALL) != -1 || errno != EINVAL ||
+	    rdp(fd, seen, sizeof(seen), 0) != -1 || errno != ENOTDIR) {
+		printf("bad arguments: [FAIL]\n");
+		ret = -1;
+	} else {
+		printf("bad arguments: [PASS]\n");
+	}
+	close(fd);
+
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		unlinkat(dirfd, name, 0);
+	}
+	unlinkat(dirfd, "link", 0);
+	unlinkat(dirfd, "sub", AT_REMOVEDIR);
+	close(dirfd);
+	rmdir(dir);
+	return ret ? ksft_exit_fail() : ksft_exit_pass();
+}
@@ -0,0 +1,140 @@
+/*
+ * vmsplice_notify.c - functional test for vmsplice(SPLICE_F_NOTIFY)
+ *
+ * Splices user pages into a pipe with a notifier attached, moves them on
+ * to a unix socket and checks that the notification only arrives once the
+ * receiver has consumed the data, i.e. once the kernel no longer holds
+ * references to the pages.
+ *
+ * Licensed under the terms of the GNU GPL License version 2
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include "../kselftest.h"
+
+#ifndef F_LINUX_SPECIFIC_BASE
+#define F_LINUX_SPECIFIC_BASE	1024
+#endif
+#ifndef F_SETPIPE_NOTIFY
+#define F_SETPIPE_NOTIFY	(F_LINUX_SPECIFIC_BASE + 11)
+#endif
+#ifndef SPLICE_F_NOTIFY
+#define SPLICE_F_NOTIFY		0x10
+#endif
+
+#define NR_PAGES	8
+
+static int wait_notify(int efd, int timeout_ms, uint64_t *count)
+{
+	struct pollfd pfd = { .fd = efd, .events = POLLIN };
+	int ret;
+
+	ret = poll(&pfd, 1, timeout_ms);
+	if (ret <= 0)
+		return ret;
+	if (read(efd, count, sizeof(*count)) != sizeof(*count))
+		return -1;
+	return 1;
+}
+
+int main(void)
+{
+	size_t len = NR_PAGES * getpagesize(), done;
+	int pfd[2], sv[2], efd;
+	struct iovec iov;
+	uint64_t count;
+	char *buf, *rbuf;
+	ssize_t ret;
+
+	buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	rbuf = malloc(len);
+	if (buf == MAP_FAILED || !rbuf) {
+		perror("alloc");
+		return ksft_exit_fail();
+	}
+	memset(buf, 0xa5, len);
+
+	if (pipe(pfd) || socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		perror("pipe/socketpair");
+		return ksft_exit_fail();
+	}
+	efd = eventfd(0, EFD_NONBLOCK);
+	if (efd < 0) {
+		perror("eventfd");
+		return ksft_exit_fail();
+	}
+
+	if (fcntl(pfd[1], F_SETPIPE_NOTIFY, efd)) {
+		if (errno == EINVAL) {
+			printf("F_SETPIPE_NOTIFY not supported, skipping\n");
+			return ksft_exit_skip();
+		}
+		perror("F_SETPIPE_NOTIFY");
+		return ksft_exit_fail();
+	}
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	ret = vmsplice(pfd[1], &iov, 1, SPLICE_F_GIFT | SPLICE_F_NOTIFY);
+	if (ret != (ssize_t) len) {
+		perror("vmsplice");
+		return ksft_exit_fail();
+	}
+
+	for (done = 0; done < len; done += ret) {
+		ret = splice(pfd[0], NULL, sv[0], NULL, len - done, 0);
+		if (ret <= 0) {
+			perror("splice");
+			return ksft_exit_fail();
+		}
+	}
+
+	/* The pages are still queued on the receiving socket */
+	if (wait_notify(efd, 200, &count) != 0) {
+		printf("notified with data in flight: [FAIL]\n");
+		return ksft_exit_fail();
+	}
+	printf("no notification while in flight: [PASS]\n");
+
+	for (done = 0; done < len; done += ret) {
+		ret = read(sv[1], rbuf + done, len - done);
+		if (ret <= 0) {
+			perror("read");
+			return ksft_exit_fail();
+		}
+	}
+	if (memcmp(buf, rbuf, len)) {
+		printf("data mismatch: [FAIL]\n");
+		return ksft_exit_fail();
+	}
+
+	if (wait_notify(efd, 5000, &count) != 1 || count != 1) {
+		printf("no notification after the data was consumed: [FAIL]\n");
+		return ksft_exit_fail();
+	}
+	printf("notification after consume: [PASS]\n");
+
+	/* Without a notifier, SPLICE_F_NOTIFY is refused */
+	if (fcntl(pfd[1], F_SETPIPE_NOTIFY, -1) ||
+	    vmsplice(pfd[1], &iov, 1, SPLICE_F_NOTIFY) != -1 ||
+	    errno != EINVAL) {
+		printf("detach notifier: [FAIL]\n");
+		return ksft_exit_fail();
+	}
+	printf("detach notifier: [PASS]\n");
+
+	return ksft_exit_pass();
+}